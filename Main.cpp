@@ -28,12 +28,19 @@
 #include "Game/RenderedMesh.h"
 #include "Game/Shapes.h"
 #include "Game/Game.h"
+#include "Game/Benchmark.h"
 
 int main(int argc, char* argv[]) {
 
 	// Init SDL
 	SDL_SetMainReady();
 
+	// Headless benchmark doesn't need a window or bgfx
+	if (argc > 1 && std::string(argv[1]) == "--benchmark") {
+		Benchmark::Run(1280, 720, 32);
+		return EXIT_SUCCESS;
+	}
+
 	if (SDL_Init(SDL_INIT_VIDEO) < 0) LOG_FATAL_AND_EXIT_ARG("Failed to init SDL: {}", SDL_GetError());
 
 	// Create window
@@ -93,6 +100,10 @@ int main(int argc, char* argv[]) {
 		Time::Tick();
 		Input::UpdateKeys();
 
+		// Last frame's trace runs during the previous bgfx::frame(), everything below (UI, movement, scene updates)
+		// reads or writes state the passes use so it has to be done first
+		Game::raytracer.WaitForFrame();
+
 		// Loop in place if paused, useful for saving CPU while staring at the screen in thought
 		if (Input::OnKeyDown(SDL_KeyCode::SDLK_SPACE)) paused = !paused;
 		if (paused) { SDL_Delay(10); continue; }
@@ -165,33 +176,23 @@ int main(int argc, char* argv[]) {
 				glm::vec3(0,0,2) * glm::sin(Time::timeF * (float)(i+1) * 0.3f);
 		}
 
-		// Update object matrices @TODO: Caching, transform hierarchies etc etc.. maybe one day
-		concurrency::parallel_for(size_t(0), Game::scene.entities.size(), [&](size_t i) {
-			auto& obj = Game::scene.entities[i];
-			obj->modelMatrix = obj->transform.ToMatrix();
-			obj->invModelMatrix = glm::inverse(obj->modelMatrix);
-			
-			// Calculate rotated AABB for every obj
-			glm::mat4x4 lowPts =  { obj->aabb.GetVertice(0), obj->aabb.GetVertice(1), obj->aabb.GetVertice(2), obj->aabb.GetVertice(3), };
-			lowPts = obj->modelMatrix * lowPts;
-			glm::mat4x4 highPts = { obj->aabb.GetVertice(4), obj->aabb.GetVertice(5), obj->aabb.GetVertice(6), obj->aabb.GetVertice(7), };
-			highPts = obj->modelMatrix * highPts;
-			AABB globalAABB = AABB(lowPts[0], lowPts[0]);
-			for (int i = 0; i < 4; i++) { globalAABB.Encapsulate(lowPts[i]); globalAABB.Encapsulate(highPts[i]); }
-			obj->worldAABB = globalAABB;
-		});
-
-		// Trace the scene
-		Game::raytracer.RenderScene(Game::scene);
+		// Update object matrices
+		Game::scene.UpdateTransforms();
+
+		// Blit the last frame and start tracing this one on worker threads
+		Game::raytracer.RenderSceneAsync(Game::scene);
 
 		// Draw UI
 		ImguiDrawer::Render();
 
-		// Dump on screen
+		// Dump on screen, uploads and presents while the trace is running
+		// Nothing after RenderSceneAsync may touch the scene or raytracer until the wait at the top of the loop
 		bgfx::frame();
 	}
 
 	// Exit cleanup
+	Game::raytracer.WaitForFrame();
+	Assets::WaitForLoads();
 	ImguiDrawer::Quit();
 	Game::window.Destroy();
 	SDL_Quit();
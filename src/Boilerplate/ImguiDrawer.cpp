@@ -3,6 +3,10 @@
 #include "Engine/Utils.h"
 #include "Engine/Time.h"
 #include "Engine/Input.h"
+#include "Engine/TexturePages.h"
+#include "Engine/Assets.h"
+#include "Engine/FrameArena.h"
+#include "Engine/MemoryStats.h"
 #include "Game/Game.h"
 #include "Game/Entity.h"
 #include "Game/RenderedMesh.h"
@@ -120,6 +124,25 @@ void ImguiDrawer::DrawUI() {
 	ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(0, 1, 1, 1));
 	ImGui::SameLine(); ImGui::Text("%.2fms", Game::raytracer.sceneTraceTimer.GetAveragedTime() * 1000.0);
 	ImGui::PopStyleColor();
+	ImGui::Checkbox("Wavefront main pass", &Game::raytracer.useWavefront);
+	ImGui::Checkbox("Progressive", &Game::raytracer.progressive);
+	ImGui::Checkbox("Sort secondary rays", &Game::raytracer.sortRays);
+	if (Game::raytracer.sortRays) {
+		ImGui::SameLine(); ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(0, 1, 1, 1));
+		ImGui::Text("%.2fms", Game::raytracer.raySortTimer.GetAveragedTime() * 1000.0); ImGui::PopStyleColor();
+	}
+	bool bilinear = Texture::filter == Texture::Filter::Bilinear;
+	if (ImGui::Checkbox("Bilinear textures", &bilinear))
+		Texture::filter = bilinear ? Texture::Filter::Bilinear : Texture::Filter::Nearest;
+	ImGui::Text("Texture pages %.1f/%.0fMB", TexturePages::ResidentBytes() / (1024.0 * 1024.0), TexturePages::memoryBudget / (1024.0 * 1024.0));
+	ImGui::Text("Frame arena %.1fMB", FrameArena::UsedBytes() / (1024.0 * 1024.0));
+	if (Assets::PendingLoads() > 0) ImGui::Text("Loading %d assets..", Assets::PendingLoads());
+	ImGui::SliderFloat("Mesh lod threshold", &Game::scene.lodThreshold, 0.0f, 0.1f, "%.3f");
+	ImGui::Checkbox("Dynamic resolution", &Game::raytracer.dynamicResolution);
+	if (Game::raytracer.dynamicResolution) {
+		ImGui::SliderFloat("Budget (ms)", &Game::raytracer.frameBudgetMs, 4.0f, 100.0f, "%.1f");
+		ImGui::Text("Trace resolution %dx%d (%.0f%%)", Game::raytracer.traceWidth, Game::raytracer.traceHeight, Game::raytracer.resolutionScale * 100.0f);
+	}
 
 	int ptCnt = 0;
 	for (const auto& light : Game::scene.lights) ptCnt += (int)light.lightBvh.points.size();
@@ -159,6 +182,15 @@ void ImguiDrawer::DrawUI() {
 		ImGui::SameLine(); ImGui::Text("%.2fms", Game::raytracer.indirectGenTimer.GetAveragedTime() * 1000.0); ImGui::PopStyleColor();
 		ImGui::SameLine(); ImGui::Text("(%d pts)", ptCnt);
 	}
+	ImGui::SliderInt("Indirect res div", &Game::raytracer.indirectSizeDiv, 1, 16);
+	ImGui::SliderInt("Indirect every N frames", &Game::raytracer.indirectInterval, 1, 16);
+	ImGui::SliderInt("Indirect tile sets", &Game::raytracer.indirectTileSets, 1, 16);
+	ImGui::Checkbox("Irradiance cache", &Game::raytracer.useIrradianceCache);
+	if (Game::raytracer.useIrradianceCache) {
+		size_t cells = 0, bytes = 0;
+		for (const auto& light : Game::scene.lights) { cells += light.irradianceCache.Count(); bytes += light.irradianceCache.MemoryUsage(); }
+		ImGui::SameLine(); ImGui::Text("(%d cells, %.1fMB)", (int)cells, bytes / (1024.0 * 1024.0));
+	}
 
 
 	// Vtx count
@@ -180,6 +212,18 @@ void ImguiDrawer::DrawUI() {
 	ImGui::Text("%d meshes, %d parametric shapes, %d lights", meshes, parametrics, Game::scene.lights.size());
 	ImGui::Text("%d vertices, %d triangles", totalVertices, totalTris);
 
+	// Memory, sampled once per frame by the raytracer, process peak is the real one from mimalloc
+	if (ImGui::CollapsingHeader("Memory")) {
+		constexpr double MB = 1024.0 * 1024.0;
+		for (int i = 0; i < MemoryStats::Count; i++) {
+			auto cat = (MemoryStats::Category)i;
+			ImGui::Text("%s %.1fMB (frame end peak %.1fMB)", MemoryStats::Name(cat), MemoryStats::Current(cat) / MB, MemoryStats::Peak(cat) / MB);
+		}
+		ImGui::Text("Process %.1fMB (peak %.1fMB)", MemoryStats::ProcessCurrent() / MB, MemoryStats::ProcessPeak() / MB);
+		static const bool mallocOverridden = MemoryStats::MallocOverridden(); // Can't change at runtime
+		ImGui::Text(mallocOverridden ? "malloc counted" : "malloc NOT counted, goes to the CRT heap");
+	}
+
 	ImGui::PopItemWidth();
 	ImGui::End();
 }
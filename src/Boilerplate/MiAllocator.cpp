@@ -0,0 +1,26 @@
+// Replacement global new/delete (all forms) forwarding to mimalloc, has to be included in exactly 1 translation unit
+#include <mimalloc-new-delete.h>
+
+// C side (malloc family used by stb, ufbx, SDL..)
+// Windows: linking mimalloc-override.lib + mimalloc-redirect.dll next to it patches the CRT malloc family when the dll loads, nothing to do here
+// Linux: glibc lets the executable define the malloc family itself so it's forwarded below
+// mimalloc has to be built with MI_OVERRIDE=OFF for this, otherwise its own override objects define the same symbols
+#if defined(__linux__)
+#include <cstdlib>
+#include <malloc.h>
+#include <mimalloc.h>
+
+extern "C" {
+	void* malloc(size_t size) noexcept { return mi_malloc(size); }
+	void* calloc(size_t count, size_t size) noexcept { return mi_calloc(count, size); }
+	void* realloc(void* p, size_t size) noexcept { return mi_realloc(p, size); }
+	void* reallocarray(void* p, size_t count, size_t size) noexcept { return mi_reallocarray(p, count, size); }
+	void free(void* p) noexcept { mi_free(p); }
+	void* aligned_alloc(size_t alignment, size_t size) noexcept { return mi_aligned_alloc(alignment, size); }
+	int posix_memalign(void** p, size_t alignment, size_t size) noexcept { return mi_posix_memalign(p, alignment, size); }
+	void* memalign(size_t alignment, size_t size) noexcept { return mi_memalign(alignment, size); }
+	void* valloc(size_t size) noexcept { return mi_valloc(size); }
+	void* pvalloc(size_t size) noexcept { return mi_pvalloc(size); }
+	size_t malloc_usable_size(void* p) noexcept { return mi_usable_size(p); }
+}
+#endif
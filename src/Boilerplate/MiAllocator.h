@@ -7,13 +7,9 @@
 
 // Bunch of not very exciting boilerplate
 
-// Replace CRT malloc with mimalloc
-#pragma warning(disable: 4595)
-inline void* operator new(size_t size) { return mi_malloc(size); }
-inline void operator delete(void* ptr) { mi_free(ptr); }
-#pragma warning(default: 4595)
-
-// malloc/free (and stl containers?) are beyond saving, needs project-wide overriding with mimalloc_redirect
+// Global new/delete are replaced with mimalloc in MiAllocator.cpp, every form incl. sized, aligned and nothrow, so all STL containers use it too
+// The malloc family goes to mimalloc as well: mimalloc-redirect.dll on Windows (copied from ext/ with the other dlls), forwarded in MiAllocator.cpp on Linux
+// MemoryStats::MallocOverridden() tells if that actually worked, a missing redirect dll silently falls back to the CRT heap
 
 // bgfx needs extra effort
 struct MiAllocator : bx::AllocatorI {
@@ -1,40 +1,182 @@
 #include "Assets.h"
 
-std::vector<std::unique_ptr<Texture>> Assets::Textures;
-std::vector<std::unique_ptr<Mesh>> Assets::Meshes;
+#include <fstream>
+
+#include "Engine/Utils.h"
+#include "Engine/Log.h"
+
+concurrency::concurrent_vector<Assets::Slot<Texture>> Assets::Textures;
+concurrency::concurrent_vector<Assets::Slot<Mesh>> Assets::Meshes;
+concurrency::task_group Assets::loads;
+std::atomic<int> Assets::pendingLoads = 0;
+
+// Shared stand-ins for assets that are still loading
+static Texture* PlaceholderTexture() {
+	static Texture placeholder(Color(0x80, 0x80, 0x80, 0xff));
+	return &placeholder;
+}
+
+static Mesh* PlaceholderMesh() {
+	static Mesh placeholder;
+	return &placeholder;
+}
+
+template <typename T>
+int Assets::Reserve(concurrency::concurrent_vector<Slot<T>>& registry, T* placeholder) {
+	auto it = registry.grow_by(1);
+	it->ptr.store(placeholder, std::memory_order_release);
+	return (int)(it - registry.begin());
+}
+
+template <typename T>
+void Assets::Publish(Slot<T>& slot, std::unique_ptr<T> asset) {
+	slot.owned = std::move(asset);
+	slot.ptr.store(slot.owned.get(), std::memory_order_release);
+	slot.ready.store(true, std::memory_order_release);
+}
 
 // Shorthands for registering assets that return the handle id
 int Assets::NewTexture(const std::filesystem::path& path, const ImportOpts& opts) {
-	auto ptr = std::make_unique<Texture>(path, opts.flipY);
-	Textures.push_back(std::move(ptr));
-	return (int)Textures.size() - 1;
+	auto ptr = std::make_unique<Texture>(path, opts.flipY, opts.textureLayout, opts.compressTexture, opts.streamTexture);
+	int handle = Reserve(Textures, ptr.get());
+	Publish(Textures[handle], std::move(ptr));
+	return handle;
 }
 
-int Assets::NewMesh(const std::filesystem::path& path, const ImportOpts& opts) {
+int Assets::NewTextureAsync(const std::filesystem::path& path, const ImportOpts& opts) {
+	int handle = Reserve(Textures, PlaceholderTexture());
+	pendingLoads++;
+	loads.run([=]() {
+		Publish(Textures[handle], std::make_unique<Texture>(path, opts.flipY, opts.textureLayout, opts.compressTexture, opts.streamTexture));
+		pendingLoads--;
+	});
+	return handle;
+}
+
+// Bump if Mesh::WriteBinary output changes
+static constexpr uint32_t MESH_CACHE_VERSION = 2;
+
+// Identifies the source file contents + options that change what gets read
+static uint64_t MeshCacheKey(const std::filesystem::path& path, const Assets::ImportOpts& opts, bool split) {
+	uint64_t key = Utils::HashFile(path);
+	key = Utils::HashBytes(&opts.loadMtl, sizeof(bool), key);
+	key = Utils::HashBytes(&split, sizeof(bool), key);
+	return Utils::HashBytes(opts.ignoreMaterials.data(), opts.ignoreMaterials.size() * sizeof(int), key);
+}
+
+// Reads preprocessed meshes written by WriteMeshCache, fails if the key doesn't match
+static bool ReadMeshCache(const std::filesystem::path& cachePath, uint64_t key, std::vector<std::unique_ptr<Mesh>>& meshes) {
+
+	if (!std::filesystem::exists(cachePath)) return false;
+
+	std::ifstream ifs(cachePath, std::ios::binary);
+	uint32_t version = 0, meshCount = 0;
+	uint64_t cachedKey = 0;
+	ifs.read((char*)&version, sizeof(uint32_t));
+	ifs.read((char*)&cachedKey, sizeof(uint64_t));
+	ifs.read((char*)&meshCount, sizeof(uint32_t));
+	if (!ifs || version != MESH_CACHE_VERSION || cachedKey != key) return false;
+
+	for (uint32_t i = 0; i < meshCount; i++) {
+		auto ptr = std::make_unique<Mesh>();
+		if (!ptr->ReadBinary(ifs)) {
+			meshes.clear();
+			return false;
+		}
+		meshes.push_back(std::move(ptr));
+	}
+	return true;
+}
+
+static void WriteMeshCache(const std::filesystem::path& cachePath, uint64_t key, const std::vector<std::unique_ptr<Mesh>>& meshes) {
+	std::ofstream ofs(cachePath, std::ios::binary);
+	if (!ofs) return;
+
+	const uint32_t meshCount = (uint32_t)meshes.size();
+	ofs.write((const char*)&MESH_CACHE_VERSION, sizeof(uint32_t));
+	ofs.write((const char*)&key, sizeof(uint64_t));
+	ofs.write((const char*)&meshCount, sizeof(uint32_t));
+	for (const auto& mesh : meshes) mesh->WriteBinary(ofs);
+}
+
+// Reads a whole mesh file into one mesh, from the preprocessed cache next to it if it's up to date
+static std::unique_ptr<Mesh> LoadMesh(const std::filesystem::path& path, const Assets::ImportOpts& opts) {
+
+	std::filesystem::path cachePath = path;
+	cachePath += ".mesh";
+	const uint64_t key = MeshCacheKey(path, opts, false);
+	std::vector<std::unique_ptr<Mesh>> meshes;
+	if (ReadMeshCache(cachePath, key, meshes) && meshes.size() == 1) {
+		fmt::println("Read {}, {} vertices, {} triangles", cachePath.string(), meshes[0]->vertices.size(), meshes[0]->triangles.size() / 3);
+		meshes[0]->ignoreMaterials = opts.ignoreMaterials;
+		if (opts.compactVertices) meshes[0]->Compact();
+		return std::move(meshes[0]);
+	}
+
 	auto ptr = std::make_unique<Mesh>();
 	ptr->ignoreMaterials = opts.ignoreMaterials;
 	ptr->LoadMesh(path, opts.loadMtl);
 	ptr->ReadAllNodes();
 	ptr->UnloadMesh();
-	Meshes.push_back(std::move(ptr));
-	return (int)Meshes.size() - 1;
+
+	meshes.clear();
+	meshes.push_back(std::move(ptr));
+	WriteMeshCache(cachePath, key, meshes); // Cache stays uncompacted, compacting is cheap next to parsing
+	if (opts.compactVertices) meshes[0]->Compact();
+	return std::move(meshes[0]);
+}
+
+int Assets::NewMesh(const std::filesystem::path& path, const ImportOpts& opts) {
+	auto ptr = LoadMesh(path, opts);
+	int handle = Reserve(Meshes, ptr.get());
+	Publish(Meshes[handle], std::move(ptr));
+	return handle;
+}
+
+int Assets::NewMeshAsync(const std::filesystem::path& path, const ImportOpts& opts) {
+	int handle = Reserve(Meshes, PlaceholderMesh());
+	pendingLoads++;
+	loads.run([=]() {
+		Publish(Meshes[handle], LoadMesh(path, opts));
+		pendingLoads--;
+	});
+	return handle;
+}
+
+int Assets::AddMesh(std::unique_ptr<Mesh> mesh) {
+	int handle = Reserve(Meshes, mesh.get());
+	Publish(Meshes[handle], std::move(mesh));
+	return handle;
+}
+
+void Assets::WaitForLoads() {
+	loads.wait();
 }
 
 void Assets::NewMeshes(const std::filesystem::path& path, std::vector<int>& meshHandles, const ImportOpts& opts) {
 
-	int numMeshes;
-	Mesh temp;
-	temp.ignoreMaterials = opts.ignoreMaterials;
-	temp.LoadMesh(path);
-	numMeshes = temp.GetMeshNodeCount();
+	std::filesystem::path cachePath = path;
+	cachePath += ".meshes";
+	const uint64_t key = MeshCacheKey(path, opts, true);
+	std::vector<std::unique_ptr<Mesh>> meshes;
 
-	for (size_t i = 0; i < numMeshes; i++) {
-		temp.ReadSceneMeshNode((int)i);
-		auto ptr = std::make_unique<Mesh>();
-		*ptr = temp; // Copy
-		Meshes.push_back(std::move(ptr));
-		meshHandles.push_back((int)Meshes.size() - 1);
+	if (ReadMeshCache(cachePath, key, meshes)) {
+		fmt::println("Read {}, {} meshes", cachePath.string(), meshes.size());
+	}
+	else {
+		Mesh temp;
+		temp.ignoreMaterials = opts.ignoreMaterials;
+		temp.LoadMesh(path);
+		meshes = temp.ReadEachNode();
+		temp.UnloadMesh();
+		WriteMeshCache(cachePath, key, meshes);
 	}
 
-	temp.UnloadMesh();
-}
\ No newline at end of file
+	for (auto& ptr : meshes) {
+		ptr->ignoreMaterials = opts.ignoreMaterials;
+		if (opts.compactVertices) ptr->Compact();
+		int handle = Reserve(Meshes, ptr.get());
+		Publish(Meshes[handle], std::move(ptr));
+		meshHandles.push_back(handle);
+	}
+}
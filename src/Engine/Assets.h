@@ -1,31 +1,80 @@
 #pragma once
 
+#include <atomic>
 #include <memory>
 #include <vector>
 #include <filesystem>
+#include <concurrent_vector.h>
+#include <ppl.h>
 
 #include "Engine/Texture.h"
 #include "Engine/Mesh.h"
 
 // Static class providing indexed access to loaded meshes and textures
+// Registering is thread safe and handles never move, async loads hand out the handle first and swap the asset in when done
 class Assets {
 	Assets(){}
 public:
-	static std::vector<std::unique_ptr<Texture>> Textures;
-	static std::vector<std::unique_ptr<Mesh>> Meshes;
+
+	// Registry entry, points to a placeholder until the asset is loaded
+	template <typename T>
+	struct Slot {
+		std::unique_ptr<T> owned;
+		std::atomic<T*> ptr = nullptr;
+		std::atomic<bool> ready = false; // Set once the real asset is in, ptr is the placeholder before that
+
+		T* operator->() const { return ptr.load(std::memory_order_acquire); }
+		T* get() const { return ptr.load(std::memory_order_acquire); }
+	};
+
+	static concurrency::concurrent_vector<Slot<Texture>> Textures;
+	static concurrency::concurrent_vector<Slot<Mesh>> Meshes;
 
 	struct ImportOpts {
 		bool flipY = false;
+		Texture::Layout textureLayout = Texture::Layout::Tiled;
+		bool compressTexture = false;
+		bool streamTexture = false; // Implies compressTexture
 		bool loadMtl = false;
+		bool compactVertices = false; // Welds and packs vertex attributes, see Mesh::Compact()
 		std::vector<int> ignoreMaterials;
 	};
 
 	// Reads a texture and returns its handle
 	static int NewTexture(const std::filesystem::path& path, const ImportOpts& opts = ImportOpts());
+
+	// Returns a handle right away and reads the texture on a worker thread, samples a flat placeholder until it's done
+	static int NewTextureAsync(const std::filesystem::path& path, const ImportOpts& opts = ImportOpts());
 	
 	// Reads a mesh file into a mesh and returns its handle
 	static int NewMesh(const std::filesystem::path& path, const ImportOpts& opts = ImportOpts());
+
+	// Returns a handle right away and reads the mesh on a worker thread
+	// Placeholder is an empty mesh, entities using it go in with Scene::AddWhenLoaded and build their BVH once the slot is ready
+	static int NewMeshAsync(const std::filesystem::path& path, const ImportOpts& opts = ImportOpts());
 	
+	// Registers an already built mesh and returns its handle
+	static int AddMesh(std::unique_ptr<Mesh> mesh);
+
 	// Reads a mesh file and splits every submesh it has into its own mesh object
 	static void NewMeshes(const std::filesystem::path& path, std::vector<int>& meshHandles, const ImportOpts& opts = ImportOpts());
+
+	// Blocks until every async load queued so far is done
+	static void WaitForLoads();
+
+	// Number of async loads still in flight
+	static int PendingLoads() { return pendingLoads; }
+
+private:
+
+	// Adds a new slot pointing at placeholder and returns its handle
+	template <typename T>
+	static int Reserve(concurrency::concurrent_vector<Slot<T>>& registry, T* placeholder);
+
+	// Moves a loaded asset into its slot
+	template <typename T>
+	static void Publish(Slot<T>& slot, std::unique_ptr<T> asset);
+
+	static concurrency::task_group loads;
+	static std::atomic<int> pendingLoads;
 };
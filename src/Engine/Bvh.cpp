@@ -391,4 +391,107 @@ void Bvh::TraverseNode(const int& nodeIndex, const glm::vec3& pos, const glm::ve
 		TraverseNode(nodeA, pos, lightpos, triMask, minDist, result, reflectPt);
 	if (distB < minDist)
 		TraverseNode(nodeB, pos, lightpos, triMask, minDist, result, reflectPt);
-}
\ No newline at end of file
+}
+
+void Bvh::BuildReflectionCache(const glm::vec3& lightpos, ReflectionCache& cache) const {
+	using namespace glm;
+
+	cache.lightpos = lightpos;
+	cache.source = this;
+	cache.dirs.resize(triangles.size() * 3);
+	cache.facing.resize(triangles.size());
+	cache.activeNodes.resize(stack.size());
+
+	// Everything in ReflectiveBarycentric that doesn't depend on the receiving pos
+	for (size_t i = 0; i < triangles.size(); i++) {
+		const BvhTriangle& tri = triangles[i];
+
+		vec3 v0r = (tri.v0 - lightpos), v1r = (tri.v1 - lightpos), v2r = (tri.v2 - lightpos);
+
+		cache.facing[i] = dot(v0r, tri.normal) <= 0.0f;
+		if (!cache.facing[i]) continue;
+
+		v0r = reflect(v0r, tri.normal);
+		v1r = reflect(v1r, tri.normal);
+		v2r = reflect(v2r, tri.normal);
+		cache.dirs[i * 3 + 0] = v0r / dot(v0r, tri.normal);
+		cache.dirs[i * 3 + 1] = v1r / dot(v1r, tri.normal);
+		cache.dirs[i * 3 + 2] = v2r / dot(v2r, tri.normal);
+	}
+
+	// Children are always pushed after their parent so going backwards fills the nodes bottom up
+	for (int i = (int)stack.size() - 1; i >= 0; i--) {
+		const auto& node = stack[i];
+		uint8_t active = 0;
+		if (node.IsLeaf()) {
+			for (int j = node.GetLeftIndex(); j < node.GetRightIndex() && !active; j++)
+				active = cache.facing[j];
+		}
+		else {
+			active = cache.activeNodes[node.GetLeftChild()] | cache.activeNodes[node.GetRightChild()];
+		}
+		cache.activeNodes[i] = active;
+	}
+
+	cache.built = true;
+}
+
+bool Bvh::GetClosestReflectiveTri(const ReflectionCache& cache, const glm::vec3& pos, const float& distLimSqr, const int& triMask,
+	BvhTriangle& result, glm::vec3& reflectPt) const {
+	if (!cache.activeNodes[0]) return false;
+	float minDist = distLimSqr;
+	TraverseNodeCached(0, cache, pos, triMask, minDist, result, reflectPt);
+	return minDist != distLimSqr;
+}
+
+void Bvh::TraverseNodeCached(const int& nodeIndex, const ReflectionCache& cache, const glm::vec3& pos, const int& triMask,
+	float& minDist, Bvh::BvhTriangle& result, glm::vec3& reflectPt) const {
+	using namespace glm;
+
+	const auto& node = stack[nodeIndex];
+
+	// Leaf, check front facing tris
+	if (node.IsLeaf()) {
+		for (int i = node.GetLeftIndex(); i < node.GetRightIndex(); i++) {
+
+			if (!cache.facing[i]) continue;
+
+			const BvhTriangle& tri = triangles[i];
+
+			if (tri.originalIndex == triMask) continue;
+
+			// Tri is planar so distance to its plane is the same from every vertex
+			const float planeDist = dot(pos - tri.v0, tri.normal);
+			const vec3* dirs = &cache.dirs[i * 3];
+			vec3 b = Utils::Barycentric(pos, tri.v0 + dirs[0] * planeDist, tri.v1 + dirs[1] * planeDist, tri.v2 + dirs[2] * planeDist);
+
+			if (b.x <= 0.0f || b.y <= 0.0f || b.z <= 0.0f) continue;
+
+			// This tri does reflect here
+			vec3 reflPt = tri.v0 * b.x + tri.v1 * b.y + tri.v2 * b.z;
+			float dist = Utils::SqrLength(reflPt - pos);
+			if (dist < minDist) {
+				minDist = dist;
+				result = tri;
+				reflectPt = reflPt;
+			}
+		}
+		return;
+	}
+
+	// Node, skip sides with nothing facing the light and check the closer one first
+	int nodeA = node.GetLeftChild();
+	int nodeB = node.GetRightChild();
+	float distA = cache.activeNodes[nodeA] ? Utils::SqrLength(stack[nodeA].aabb.ClosestPoint(pos) - pos) : std::numeric_limits<float>::max();
+	float distB = cache.activeNodes[nodeB] ? Utils::SqrLength(stack[nodeB].aabb.ClosestPoint(pos) - pos) : std::numeric_limits<float>::max();
+
+	if (distB < distA) {
+		std::swap(nodeA, nodeB);
+		std::swap(distA, distB);
+	}
+
+	if (distA < minDist)
+		TraverseNodeCached(nodeA, cache, pos, triMask, minDist, result, reflectPt);
+	if (distB < minDist)
+		TraverseNodeCached(nodeB, cache, pos, triMask, minDist, result, reflectPt);
+}
@@ -46,6 +46,9 @@ public:
 
 	bool Exists() const { return stack.size() != 0; }
 
+	// Bytes held by nodes + triangles
+	size_t MemoryUsage() const { return stack.capacity() * sizeof(BvhNode) + triangles.capacity() * sizeof(BvhTriangle); }
+
 	// Intersects a ray against this bvh
 	float Intersect(const Ray& ray, glm::vec3& normal, int& minIndex, float& depth) const;
 
@@ -59,6 +62,26 @@ public:
 	bool GetClosestReflectiveTri(const glm::vec3& pos, const glm::vec3& lightpos, const float& distLimSqr, const int& triMask,
 		BvhTriangle& result, glm::vec3& reflectPt) const;
 
+	// Light dependent part of ReflectiveBarycentric for every triangle, valid as long as the local space light pos doesn't change
+	// Reflected vertex directions are prescaled so projecting them to a receiving pos is just 1 dot + 3 madds per tri
+	struct ReflectionCache {
+		glm::vec3 lightpos = glm::vec3(0.0f); // Local space light pos this was built for
+		const Bvh* source = nullptr; // Bvh this was built from, lods each need their own
+		std::vector<glm::vec3> dirs; // 3 per triangle
+		std::vector<uint8_t> facing; // Per triangle, 0 if backfacing to the light and can never reflect
+		std::vector<uint8_t> activeNodes; // Per node, 0 if nothing under it faces the light
+		bool built = false;
+
+		bool IsValid(const Bvh& bvh, const glm::vec3& pos) const { return built && source == &bvh && lightpos == pos; }
+	};
+
+	// Fills the cache for a pointlight at lightpos
+	void BuildReflectionCache(const glm::vec3& lightpos, ReflectionCache& cache) const;
+
+	// Same as above but uses precomputed light data, result should match the uncached version
+	bool GetClosestReflectiveTri(const ReflectionCache& cache, const glm::vec3& pos, const float& distLimSqr, const int& triMask,
+		BvhTriangle& result, glm::vec3& reflectPt) const;
+
 private:
 
 	// Concurrent stack used during generation
@@ -88,4 +111,7 @@ private:
 		float& minDist, Bvh::BvhTriangle& result, glm::vec3& reflectPt) const;
 
 	bool ReflectiveBarycentric(const glm::vec3& lightpos, const glm::vec3& pos, const BvhTriangle& tri, glm::vec3& bary) const;
+
+	void TraverseNodeCached(const int& nodeIndex, const ReflectionCache& cache, const glm::vec3& pos, const int& triMask,
+		float& minDist, Bvh::BvhTriangle& result, glm::vec3& reflectPt) const;
 };
@@ -45,6 +45,9 @@ public:
 
 	bool Exists() const { return stack.size() != 0; }
 
+	// Bytes held by nodes + points, capacity since they're reused every frame
+	size_t MemoryUsage() const { return stack.capacity() * sizeof(BvhNode) + points.capacity() * sizeof(BvhPointData); }
+
 	// Clears the data this bvh holds
 	void Clear();
 
@@ -73,6 +73,12 @@ bool AABB::Contains(const glm::vec3& pt) const {
            pt.z >= min.z && pt.z <= max.z;
 }
 
+bool AABB::Overlaps(const AABB& other) const {
+    return min.x <= other.max.x && max.x >= other.min.x &&
+           min.y <= other.max.y && max.y >= other.min.y &&
+           min.z <= other.max.z && max.z >= other.min.z;
+}
+
 void AABB::Encapsulate(const glm::vec3& point) {
     min = glm::min(point, min);
     max = glm::max(point, max);
@@ -8,6 +8,11 @@
 struct Ray {
     glm::vec3 ro, rd, inv_rd;
     int mask;
+
+    // Ray cone for texture LOD, width at ro and how much it widens per unit traveled (0 = infinitely thin)
+    float coneWidth = 0.0f, coneSpread = 0.0f;
+
+    float ConeWidthAt(const float& dist) const { return coneWidth + coneSpread * dist; }
 };
 
 // Color structure for 4 byte colors
@@ -50,6 +55,9 @@ struct AABB {
     // Returns if this AABB contains given point
     bool Contains(const glm::vec3& pt) const;
 
+    // Returns if this AABB overlaps with other
+    bool Overlaps(const AABB& other) const;
+
     // Grows the size of AABB to contain given point
     void Encapsulate(const glm::vec3& point);
 
@@ -81,6 +89,7 @@ struct v2f {
     glm::vec3 worldNormal;
     glm::vec3 rayDirection;
     glm::vec2 uv;
+    float uvFootprint = 0.0f; // Uv units covered by the ray cone here, used to pick texture mips
 };
 
 // Light's indirect buffer BVH payload struct
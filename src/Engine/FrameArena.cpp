@@ -0,0 +1,54 @@
+#include "FrameArena.h"
+
+#include <algorithm>
+
+std::atomic<uint32_t> FrameArena::generation = 0;
+std::atomic<size_t> FrameArena::usedBytes = 0;
+
+// Blocks owned by a single thread, freed when the thread exits
+struct ThreadArena {
+	struct Block {
+		std::unique_ptr<std::byte[]> data;
+		size_t size;
+	};
+	std::vector<Block> blocks;
+	size_t block = 0, offset = 0;
+	uint32_t generation = 0;
+};
+
+void FrameArena::Reset() {
+	// Threads notice the new generation on their next allocation and rewind, nothing here touches other threads' arenas
+	generation++;
+	usedBytes = 0;
+}
+
+void* FrameArena::Allocate(size_t bytes, size_t align) {
+	thread_local ThreadArena arena;
+
+	const uint32_t gen = generation.load(std::memory_order_relaxed);
+	if (arena.generation != gen) {
+		arena.generation = gen;
+		arena.block = 0;
+		arena.offset = 0;
+	}
+
+	// Next block that fits, blocks skipped over just sit unused for the rest of the frame
+	while (arena.block < arena.blocks.size()) {
+		const size_t start = (arena.offset + align - 1) & ~(align - 1);
+		if (start + bytes <= arena.blocks[arena.block].size) {
+			arena.offset = start + bytes;
+			usedBytes.fetch_add(bytes, std::memory_order_relaxed);
+			return arena.blocks[arena.block].data.get() + start;
+		}
+		arena.block++;
+		arena.offset = 0;
+	}
+
+	// Out of blocks, new ones are aligned by new[] for anything up to max_align_t
+	const size_t size = std::max(BLOCK_SIZE, bytes);
+	arena.blocks.push_back(ThreadArena::Block{ .data = std::make_unique_for_overwrite<std::byte[]>(size), .size = size });
+	arena.block = arena.blocks.size() - 1;
+	arena.offset = bytes;
+	usedBytes.fetch_add(bytes, std::memory_order_relaxed);
+	return arena.blocks.back().data.get();
+}
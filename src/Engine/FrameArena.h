@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <type_traits>
+#include <vector>
+#include <ppl.h> // Parallel for
+
+// Per thread bump allocators for buffers that only live for one frame
+// Memory is handed out linearly and everything is dropped at once in Reset(), blocks stay allocated for the next frame
+class FrameArena {
+	FrameArena() {}
+public:
+
+	// Size of a single block, bigger allocations get a block of their own
+	static constexpr size_t BLOCK_SIZE = 4 * 1024 * 1024;
+
+	// Returns uninitialized memory for count Ts from the calling thread's arena, valid until the next Reset()
+	template <typename T>
+	static std::span<T> Alloc(size_t count) {
+		static_assert(std::is_trivially_destructible_v<T>, "Arena memory is never destructed");
+		return { (T*)Allocate(count * sizeof(T), alignof(T)), count };
+	}
+
+	// Copies elements of src that pass keep to a new arena array in the same order, counts and copies in parallel
+	template <typename T, typename Pred>
+	static std::span<T> Compact(std::span<const T> src, Pred keep);
+
+	// Invalidates everything allocated so far, call between frames when nothing holds arena memory
+	static void Reset();
+
+	// Bytes handed out since the last reset
+	static size_t UsedBytes() { return usedBytes; }
+
+private:
+
+	static void* Allocate(size_t bytes, size_t align);
+
+	static std::atomic<uint32_t> generation;
+	static std::atomic<size_t> usedBytes;
+};
+
+template <typename T, typename Pred>
+std::span<T> FrameArena::Compact(std::span<const T> src, Pred keep) {
+
+	// Chunks of src, each gets its own output range from a prefix sum of kept counts
+	constexpr size_t CHUNK = 4096;
+	const size_t numChunks = (src.size() + CHUNK - 1) / CHUNK;
+	std::span<size_t> offsets = Alloc<size_t>(numChunks + 1);
+
+	offsets[0] = 0;
+	concurrency::parallel_for(size_t(0), numChunks, [&](size_t c) {
+		size_t cnt = 0;
+		for (size_t i = c * CHUNK; i < std::min(src.size(), (c + 1) * CHUNK); i++)
+			if (keep(src[i])) cnt++;
+		offsets[c + 1] = cnt;
+	});
+	for (size_t c = 0; c < numChunks; c++) offsets[c + 1] += offsets[c];
+
+	std::span<T> ret = Alloc<T>(offsets[numChunks]);
+	concurrency::parallel_for(size_t(0), numChunks, [&](size_t c) {
+		size_t dst = offsets[c];
+		for (size_t i = c * CHUNK; i < std::min(src.size(), (c + 1) * CHUNK); i++)
+			if (keep(src[i])) ret[dst++] = src[i];
+	});
+
+	return ret;
+}
@@ -0,0 +1,52 @@
+#include "MemoryStats.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fmt/core.h>
+#include <mimalloc.h>
+
+size_t MemoryStats::current[MemoryStats::Count] = {};
+size_t MemoryStats::peak[MemoryStats::Count] = {};
+
+const char* MemoryStats::Name(Category category) {
+	switch (category) {
+		case Meshes: return "Meshes";
+		case Textures: return "Textures";
+		case Bvhs: return "BVHs";
+		case LightBuffers: return "Light buffers";
+		case FrameTemp: return "Frame temporaries";
+		default: return "?";
+	}
+}
+
+void MemoryStats::Set(Category category, size_t bytes) {
+	current[category] = bytes;
+	peak[category] = std::max(peak[category], bytes);
+}
+
+// Committed memory is what mimalloc actually holds, rss would also count the exe, driver etc.
+size_t MemoryStats::ProcessCurrent() {
+	size_t currentCommit = 0;
+	mi_process_info(nullptr, nullptr, nullptr, nullptr, nullptr, &currentCommit, nullptr, nullptr);
+	return currentCommit;
+}
+
+size_t MemoryStats::ProcessPeak() {
+	size_t peakCommit = 0;
+	mi_process_info(nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, &peakCommit, nullptr);
+	return peakCommit;
+}
+
+bool MemoryStats::MallocOverridden() {
+	void* p = std::malloc(64);
+	const bool overridden = mi_is_in_heap_region(p);
+	std::free(p);
+	return overridden;
+}
+
+void MemoryStats::Print() {
+	constexpr double MB = 1024.0 * 1024.0;
+	for (int i = 0; i < Count; i++)
+		fmt::println("{}: {:.1f}MB (frame end peak {:.1f}MB)", Name((Category)i), current[i] / MB, peak[i] / MB);
+	fmt::println("Process: {:.1f}MB (peak {:.1f}MB), malloc {}", ProcessCurrent() / MB, ProcessPeak() / MB, MallocOverridden() ? "counted" : "NOT counted, goes to the CRT heap");
+}
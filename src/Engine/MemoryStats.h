@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+
+// Memory used per subsystem, the owners of the data report their current totals once per frame
+// Category peaks are the highest of those end of frame samples, anything freed before the frame ends (import temporaries, mid frame buffers) never shows up in them
+// The process peak comes from mimalloc itself and does include those
+class MemoryStats {
+	MemoryStats() {}
+public:
+
+	enum Category { Meshes, Textures, Bvhs, LightBuffers, FrameTemp, Count };
+
+	static const char* Name(Category category);
+
+	// Sets the current bytes of a category and updates its sampled peak
+	static void Set(Category category, size_t bytes);
+
+	static size_t Current(Category category) { return current[category]; }
+	static size_t Peak(Category category) { return peak[category]; }
+
+	// Whole process as seen by mimalloc, includes everything not tracked above
+	static size_t ProcessCurrent();
+	static size_t ProcessPeak();
+
+	// Whether plain malloc ends up in mimalloc, ie. C libraries (stb, ufbx, SDL..) are counted in the process totals
+	static bool MallocOverridden();
+
+	// Prints every category + process totals
+	static void Print();
+
+private:
+	static size_t current[Count], peak[Count];
+};
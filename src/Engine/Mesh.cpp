@@ -1,149 +1,145 @@
 #include "Mesh.h"
 
 #include <glm/gtc/quaternion.hpp>
+#include <algorithm>
+#include <cstring>
+#include <atomic>
+#include <istream>
+#include <ostream>
+#include <unordered_map>
+#include <ppl.h> // Parallel for
 
 #include "Engine/Utils.h"
 #include "Engine/Log.h"
 
-int Mesh::ReadNode(int i, int vertexOffset) {
-
-    // Returns the number of vertices read
-
-    ufbx_node* node = nullptr;
-    int cnt = 0;
+std::vector<ufbx_node*> Mesh::GetMeshNodes() const {
+    std::vector<ufbx_node*> nodes;
+    for (size_t i = 0; i < scene->nodes.count; i++) {
+        ufbx_node* node = scene->nodes.data[i];
+        if (!node->is_root && node->mesh) nodes.push_back(node);
+    }
+    return nodes;
+}
 
-    // Skip nodes until mesh #i
-    for (size_t j = 0; j < scene->nodes.count; j++) {
-        node = scene->nodes.data[j];
-        if (node->is_root) continue;
-        if (!node->mesh) continue;
-        if (cnt++ == i) break;
+size_t Mesh::CountNodeTriangles(const ufbx_node* node) const {
+    const ufbx_mesh* mesh = node->mesh;
+    size_t cnt = 0;
+    for (size_t i = 0; i < mesh->faces.count; i++) {
+        const auto& face = mesh->faces.data[i];
+        if (face.num_indices != 3 && face.num_indices != 4) continue;
+        if (Utils::Contains(ignoreMaterials, GetFaceMaterial(mesh, i))) continue;
+        cnt += face.num_indices - 2;
     }
+    return cnt;
+}
 
-    if (node == nullptr) return 0;
+int Mesh::GetFaceMaterial(const ufbx_mesh* mesh, size_t face) const {
+    if (mesh->materials.count == 0) return 0;
+    const auto& internalId = mesh->face_material.data[face];
+    int matIndex = mesh->materials.data[internalId].material->typed_id;
+    if (matIndex >= scene->materials.count)
+        LOG_FATAL_AND_EXIT("Model has tri material indices outside material array length");
+    return matIndex;
+}
 
-    std::vector<int> seenMaterials;
+void Mesh::ReadNode(const ufbx_node* node, size_t vertexOffset, size_t triOffset) {
 
-    ufbx_mesh* mesh = node->mesh;
-    ufbx_vec3* meshVerts = mesh->vertices.data;
-    uint32_t* meshIndices = mesh->vertex_indices.data;
+    // Arrays are already sized, this node only writes to its own range so nodes can be read in parallel
 
-    vertices.reserve(vertices.size() + mesh->vertices.count);
-    triangles.reserve(vertices.size());
-    colors.reserve(vertices.size());
-    uvs.reserve(vertices.size());
-    normals.reserve(vertices.size());
-    materialIDs.reserve(vertices.size());
-    connectivity.reserve(vertices.size());
+    const ufbx_mesh* mesh = node->mesh;
+    const uint32_t* meshIndices = mesh->vertex_indices.data;
 
     // Vertices, uvs, normals, vertex colors
     for (size_t i = 0; i < mesh->vertex_position.values.count; i++) {
+        const size_t vi = vertexOffset + i;
         const auto& vd = mesh->vertex_position.values.data[i];
-        vertices.push_back(glm::vec3((float)vd.x, (float)vd.y, (float)vd.z));
+        vertices[vi] = glm::vec3((float)vd.x, (float)vd.y, (float)vd.z);
 
         auto firstIndex = mesh->vertex_first_index[i];
 
-        connectivity.emplace_back();
-        
         if (mesh->vertex_color.exists && firstIndex != UFBX_NO_INDEX) {
             const auto& clr = mesh->vertex_color.values[mesh->vertex_color.indices[firstIndex]];
-            colors.push_back(glm::vec4((float)clr.x, (float)clr.y, (float)clr.z, (float)clr.w));
-            hasColors = true;
+            colors[vi] = glm::vec4((float)clr.x, (float)clr.y, (float)clr.z, (float)clr.w);
         }
-        else colors.push_back(glm::vec4(1, 1, 1, 1));
+        else colors[vi] = glm::vec4(1, 1, 1, 1);
 
         if (mesh->vertex_uv.exists && firstIndex != UFBX_NO_INDEX) {
             const auto& uv = mesh->vertex_uv.values[mesh->vertex_uv.indices[firstIndex]];
-
-            uvs.push_back(glm::vec2((float)uv.x, (float)uv.y));
-            hasUVs = true;
+            uvs[vi] = glm::vec2((float)uv.x, (float)uv.y);
         }
-        else uvs.push_back(glm::vec2(0, 0));
+        else uvs[vi] = glm::vec2(0, 0);
 
         if (mesh->vertex_normal.exists && firstIndex != UFBX_NO_INDEX) {
             const auto& nrm = mesh->vertex_normal.values[mesh->vertex_normal.indices[firstIndex]];
-            normals.push_back(glm::normalize(glm::vec3((float)nrm.x, (float)nrm.y, (float)nrm.z)));
-            hasNormals = true;
+            normals[vi] = glm::normalize(glm::vec3((float)nrm.x, (float)nrm.y, (float)nrm.z));
         }
-        else normals.push_back(glm::vec3(0, 1, 0));
+        else normals[vi] = glm::vec3(0, 1, 0);
     }
 
+    // Adds triangle abc at triOffset
+    const uint32_t vo = (uint32_t)vertexOffset;
+    auto addTri = [&](uint32_t a, uint32_t b, uint32_t c, int matIndex) {
+        const size_t idx = triOffset * 3;
+        triangles[idx + 0] = vo + a;
+        triangles[idx + 1] = vo + b;
+        triangles[idx + 2] = vo + c;
+        materialIDs[triOffset++] = matIndex;
+    };
+
     // Triangles
     for (size_t i = 0; i < mesh->faces.count; i++) {
-        auto face = mesh->faces.data[i];
+        const auto& face = mesh->faces.data[i];
+        if (face.num_indices != 3 && face.num_indices != 4) continue;
 
-        int matIndex = 0;
-        if (mesh->materials.count > 0) {
-            const auto& internalId = mesh->face_material.data[i];
-            matIndex = mesh->materials.data[internalId].material->typed_id;
-            if (matIndex >= scene->materials.count)
-                LOG_FATAL_AND_EXIT("Model has tri material indices outside material array length");
-
-            if (!Utils::Contains(seenMaterials, matIndex)) seenMaterials.push_back(matIndex);
-        }
+        const int matIndex = GetFaceMaterial(mesh, i);
+        if (Utils::Contains(ignoreMaterials, matIndex)) continue;
 
         const auto i0 = meshIndices[face.index_begin + 0];
         const auto i1 = meshIndices[face.index_begin + 1];
         const auto i2 = meshIndices[face.index_begin + 2];
+        addTri(i0, i1, i2, matIndex);
 
-        if (std::find(ignoreMaterials.begin(), ignoreMaterials.end(), matIndex) != ignoreMaterials.end())
-            continue;
-
-        if (face.num_indices == 3) {
-            connectivity[vertexOffset + i0].push_back((uint32_t)triangles.size());
-            connectivity[vertexOffset + i1].push_back((uint32_t)triangles.size());
-            connectivity[vertexOffset + i2].push_back((uint32_t)triangles.size());
-
-            triangles.push_back(vertexOffset + i0);
-            triangles.push_back(vertexOffset + i1);
-            triangles.push_back(vertexOffset + i2);
-            materialIDs.push_back(matIndex);
-        }
+        if (face.num_indices == 4) addTri(i0, i2, meshIndices[face.index_begin + 3], matIndex);
+    }
+}
 
-        else if (face.num_indices == 4) {
-            const auto i3 = meshIndices[face.index_begin + 3];
-        
-            connectivity[vertexOffset + i0].push_back((uint32_t)triangles.size());
-            connectivity[vertexOffset + i1].push_back((uint32_t)triangles.size());
-            connectivity[vertexOffset + i2].push_back((uint32_t)triangles.size());
-        
-            triangles.push_back(vertexOffset + i0);
-            triangles.push_back(vertexOffset + i1);
-            triangles.push_back(vertexOffset + i2);
-            materialIDs.push_back(matIndex);
-
-            connectivity[vertexOffset + i0].push_back((uint32_t)triangles.size());
-            connectivity[vertexOffset + i2].push_back((uint32_t)triangles.size());
-            connectivity[vertexOffset + i3].push_back((uint32_t)triangles.size());
-        
-            triangles.push_back(vertexOffset + i0);
-            triangles.push_back(vertexOffset + i2);
-            triangles.push_back(vertexOffset + i3);
-            materialIDs.push_back(matIndex);
-        }
+void Mesh::ReadNodes(const std::vector<ufbx_node*>& nodes) {
+
+    // Prefix sums of vertex/triangle counts give every node its own range in the merged arrays
+    std::vector<size_t> vertexOffsets(nodes.size() + 1, 0), triOffsets(nodes.size() + 1, 0);
+    concurrency::parallel_for(size_t(0), nodes.size(), [&](size_t i) {
+        vertexOffsets[i + 1] = nodes[i]->mesh->vertex_position.values.count;
+        triOffsets[i + 1] = CountNodeTriangles(nodes[i]);
+    });
+    for (size_t i = 0; i < nodes.size(); i++) {
+        vertexOffsets[i + 1] += vertexOffsets[i];
+        triOffsets[i + 1] += triOffsets[i];
     }
 
-    numUniqueMaterials = (int)seenMaterials.size();
-
-#if false // Debugging
-    // Update triangle connectivity
-    triConnectivity.resize(triangles.size() / 3);
-
-    for (size_t vi = 0; vi < vertices.size(); vi++) {
-        // For every vertice, loop each triangle it has and add to every neighbor if not present
-        const auto& vertNeighborTris = connectivity[vi];
-        for (const auto& tri : vertNeighborTris) {
-            auto& triNeighborTris = triConnectivity[tri / 3];
-            for (const auto& otherTri : vertNeighborTris) {
-                if (otherTri == tri) continue;
-                if (Utils::Contains(triNeighborTris, otherTri)) continue;
-                triNeighborTris.push_back(otherTri);
-            }
-        }
+    const size_t numVerts = vertexOffsets.back(), numTris = triOffsets.back();
+    vertices.resize(numVerts);
+    colors.resize(numVerts);
+    uvs.resize(numVerts);
+    normals.resize(numVerts);
+    triangles.resize(numTris * 3);
+    materialIDs.resize(numTris);
+
+    concurrency::parallel_for(size_t(0), nodes.size(), [&](size_t i) {
+        ReadNode(nodes[i], vertexOffsets[i], triOffsets[i]);
+    });
+
+    // Flags and material counts from all nodes
+    for (const auto* node : nodes) {
+        hasColors |= node->mesh->vertex_color.exists;
+        hasUVs |= node->mesh->vertex_uv.exists;
+        hasNormals |= node->mesh->vertex_normal.exists;
     }
-#endif
+    std::vector<bool> seenMaterials(glm::max(scene->materials.count, (size_t)1), false);
+    for (const auto& id : materialIDs) seenMaterials[id] = true;
+    numUniqueMaterials = (int)std::count(seenMaterials.begin(), seenMaterials.end(), true);
 
-    return (int)mesh->vertices.count;
+    // Smooth normals instead of flat face normals when the file has none
+    if (!hasNormals) GenerateNormals();
 }
 
 void Mesh::CheckData() {
@@ -176,9 +172,12 @@ void Mesh::UnloadMesh() {
 }
 
 void Mesh::Clear() {
-    connectivity.clear();
-    triConnectivity.clear();
+    ClearAdjacency();
     materialMetadata.clear();
+    packedNormals.clear();
+    packedUVs.clear();
+    packedColors.clear();
+    compact = false;
     vertices.clear();
     triangles.clear();
     materialIDs.clear();
@@ -219,10 +218,7 @@ void Mesh::ReadAllNodes() {
 
     ReadTextures();
 
-    int meshCount = GetMeshNodeCount();
-    int vertexCnt = 0;
-    for (size_t i = 0; i < meshCount; i++)
-        vertexCnt += ReadNode((int)i, vertexCnt);
+    ReadNodes(GetMeshNodes());
     CheckData();
 
     fmt::println("Read a mesh with {} vertices, {} triangles and {} materials.", vertices.size(), triangles.size() / 3, scene->materials.count);
@@ -235,35 +231,244 @@ void Mesh::ReadSceneMeshNode(int nodeIndex) {
 
     Clear();
 
-    if (nodeIndex < 0 || nodeIndex >= scene->nodes.count)
+    const auto nodes = GetMeshNodes();
+    if (nodeIndex < 0 || nodeIndex >= nodes.size())
         LOG_FATAL_AND_EXIT("Tried to read a mesh file node past file scene indices");
 
     ReadTextures();
 
-    ReadNode(nodeIndex, 0);
+    ReadNodes({ nodes[nodeIndex] });
     CheckData();
 
     fmt::println("Read a mesh with {} vertices, {} triangles and {} materials.", vertices.size(), triangles.size() / 3, scene->materials.count);
     fmt::println("Has UVs: {}, Has Normals: {}, Has Colors: {}", hasUVs, hasNormals, hasColors);
 }
 
+std::vector<std::unique_ptr<Mesh>> Mesh::ReadEachNode() {
+    if (scene == nullptr)
+        LOG_FATAL_AND_EXIT("Reading scene with no scene loaded");
+
+    Clear();
+
+    // Node list and materials once for the whole file, every node only converts its own geometry
+    ReadTextures();
+    const auto nodes = GetMeshNodes();
+
+    std::vector<std::unique_ptr<Mesh>> meshes(nodes.size());
+    concurrency::parallel_for(size_t(0), nodes.size(), [&](size_t i) {
+        auto mesh = std::make_unique<Mesh>();
+        mesh->scene = scene; // Borrowed for reading, this keeps owning it
+        mesh->ignoreMaterials = ignoreMaterials;
+        mesh->materialMetadata = materialMetadata;
+        mesh->ReadNodes({ nodes[i] });
+        mesh->CheckData();
+        mesh->scene = nullptr;
+        meshes[i] = std::move(mesh);
+    });
+
+    fmt::println("Read {} meshes with {} materials.", meshes.size(), scene->materials.count);
+    return meshes;
+}
+
 int Mesh::GetMeshNodeCount() {
 
     if (scene == nullptr) LOG_FATAL_AND_EXIT("No mesh loaded?");
 
-    int cnt = 0;
-    for (size_t i = 0; i < scene->nodes.count; i++)
-        if (!scene->nodes[i]->is_root && scene->nodes[i]->mesh)
-            cnt++;
+    return (int)GetMeshNodes().size();
+}
 
-    return cnt;
+const Mesh::Adjacency& Mesh::GetVertexTriangles() const {
+    if (vertexTrianglesBuilt.load(std::memory_order_acquire)) return vertexTriangles;
+
+    std::lock_guard lock(adjacencyLock);
+    if (vertexTrianglesBuilt.load(std::memory_order_relaxed)) return vertexTriangles;
+
+    // Counting sort, count uses per vertex -> prefix sum -> scatter
+    const size_t numTris = triangles.size() / 3;
+    auto& adj = vertexTriangles;
+    adj.offsets.assign(vertices.size() + 1, 0);
+    concurrency::parallel_for(size_t(0), triangles.size(), [&](size_t i) {
+        std::atomic_ref<uint32_t>(adj.offsets[triangles[i] + 1]).fetch_add(1, std::memory_order_relaxed);
+    });
+    for (size_t i = 0; i < vertices.size(); i++)
+        adj.offsets[i + 1] += adj.offsets[i];
+
+    std::vector<uint32_t> cursor(adj.offsets.begin(), adj.offsets.end() - 1);
+    adj.items.resize(triangles.size());
+    concurrency::parallel_for(size_t(0), numTris, [&](size_t t) {
+        for (int j = 0; j < 3; j++) {
+            const uint32_t slot = std::atomic_ref<uint32_t>(cursor[triangles[t * 3 + j]]).fetch_add(1, std::memory_order_relaxed);
+            adj.items[slot] = (uint32_t)t;
+        }
+    });
+
+    // Scatter order depends on threads, sort rows so results are the same every run
+    concurrency::parallel_for(size_t(0), vertices.size(), [&](size_t v) {
+        std::sort(adj.items.begin() + adj.offsets[v], adj.items.begin() + adj.offsets[v + 1]);
+    });
+
+    vertexTrianglesBuilt.store(true, std::memory_order_release);
+    return adj;
+}
+
+const Mesh::Adjacency& Mesh::GetTriangleNeighbors() const {
+    if (triangleNeighborsBuilt.load(std::memory_order_acquire)) return triangleNeighbors;
+
+    // Before taking the lock, it builds under the same one
+    const auto& vertTris = GetVertexTriangles();
+
+    std::lock_guard lock(adjacencyLock);
+    if (triangleNeighborsBuilt.load(std::memory_order_relaxed)) return triangleNeighbors;
+    const size_t numTris = triangles.size() / 3;
+
+    // Unique tris around the 3 corners, minus itself
+    auto gather = [&](size_t t, std::vector<uint32_t>& out) {
+        out.clear();
+        for (int j = 0; j < 3; j++)
+            for (const auto& other : vertTris[triangles[t * 3 + j]])
+                if (other != t) out.push_back(other);
+        std::sort(out.begin(), out.end());
+        out.erase(std::unique(out.begin(), out.end()), out.end());
+    };
+
+    // Counts first so items can be written in place, gathers twice instead of keeping per tri lists around
+    auto& adj = triangleNeighbors;
+    adj.offsets.assign(numTris + 1, 0);
+    concurrency::parallel_for(size_t(0), numTris, [&](size_t t) {
+        thread_local std::vector<uint32_t> temp;
+        gather(t, temp);
+        adj.offsets[t + 1] = (uint32_t)temp.size();
+    });
+    for (size_t i = 0; i < numTris; i++)
+        adj.offsets[i + 1] += adj.offsets[i];
+
+    adj.items.resize(adj.offsets.back());
+    concurrency::parallel_for(size_t(0), numTris, [&](size_t t) {
+        thread_local std::vector<uint32_t> temp;
+        gather(t, temp);
+        std::copy(temp.begin(), temp.end(), adj.items.begin() + adj.offsets[t]);
+    });
+
+    triangleNeighborsBuilt.store(true, std::memory_order_release);
+    return adj;
+}
+
+void Mesh::ClearAdjacency() {
+    vertexTrianglesBuilt = false;
+    triangleNeighborsBuilt = false;
+    vertexTriangles.clear();
+    triangleNeighbors.clear();
+}
+
+void Mesh::GenerateNormals() {
+    if (compact || vertices.empty()) return;
+
+    const auto& vertTris = GetVertexTriangles();
+    normals.resize(vertices.size());
+
+    // Unnormalized cross product is twice the triangle area so bigger triangles weigh more
+    concurrency::parallel_for(size_t(0), vertices.size(), [&](size_t v) {
+        glm::vec3 sum = glm::vec3(0.0f);
+        for (const auto& t : vertTris[v]) {
+            const auto& p0 = vertices[triangles[t * 3 + 0]];
+            const auto& p1 = vertices[triangles[t * 3 + 1]];
+            const auto& p2 = vertices[triangles[t * 3 + 2]];
+            sum += glm::cross(p1 - p0, p2 - p0);
+        }
+        const float len = glm::length(sum);
+        normals[v] = len > 0.0f ? sum / len : glm::vec3(0, 1, 0);
+    });
+    hasNormals = true;
+
+    // Nothing else reads it at import, no need to keep it around
+    ClearAdjacency();
+}
+
+size_t Mesh::MemoryUsage() const {
+    return vertices.capacity() * sizeof(glm::vec3) + triangles.capacity() * sizeof(uint32_t) + uvs.capacity() * sizeof(glm::vec2)
+        + normals.capacity() * sizeof(glm::vec3) + colors.capacity() * sizeof(glm::vec4) + materialIDs.capacity() * sizeof(int)
+        + (packedNormals.capacity() + packedUVs.capacity() + packedColors.capacity()) * sizeof(uint32_t)
+        + (vertexTriangles.offsets.capacity() + vertexTriangles.items.capacity()) * sizeof(uint32_t)
+        + (triangleNeighbors.offsets.capacity() + triangleNeighbors.items.capacity()) * sizeof(uint32_t);
 }
 
 void Mesh::RotateVertices(const glm::quat& rotation) {
-    for (size_t i = 0; i < vertices.size(); i++) {
+    for (size_t i = 0; i < vertices.size(); i++)
         vertices.data()[i] = rotation * vertices.data()[i];
+    for (size_t i = 0; i < normals.size(); i++)
         normals.data()[i] = rotation * normals.data()[i];
+    for (size_t i = 0; i < packedNormals.size(); i++)
+        packedNormals[i] = EncodeNormal(rotation * DecodeNormal(packedNormals[i]));
+}
+
+uint32_t Mesh::EncodeNormal(const glm::vec3& n) {
+    glm::vec2 p = glm::vec2(n.x, n.y) / (glm::abs(n.x) + glm::abs(n.y) + glm::abs(n.z));
+    if (n.z < 0.0f) {
+        const glm::vec2 s = glm::vec2(p.x >= 0.0f ? 1.0f : -1.0f, p.y >= 0.0f ? 1.0f : -1.0f);
+        p = (1.0f - glm::abs(glm::vec2(p.y, p.x))) * s;
     }
+    return glm::packSnorm2x16(p);
+}
+
+void Mesh::Compact() {
+    if (compact) return;
+
+    const size_t oldCount = vertices.size();
+    const size_t oldBytes = oldCount * (sizeof(glm::vec3) * 2 + sizeof(glm::vec2) + sizeof(glm::vec4));
+
+    // Quantize first so vertices that only differed below the packed precision get welded too
+    std::vector<uint32_t> nrm(hasNormals ? oldCount : 0), uv(hasUVs ? oldCount : 0), clr(hasColors ? oldCount : 0);
+    concurrency::parallel_for(size_t(0), oldCount, [&](size_t i) {
+        if (hasNormals) nrm[i] = EncodeNormal(normals[i]);
+        if (hasUVs) uv[i] = glm::packHalf2x16(uvs[i]);
+        if (hasColors) clr[i] = glm::packUnorm4x8(glm::clamp(colors[i], 0.0f, 1.0f));
+    });
+
+    // Weld vertices that are identical in every stream we keep
+    struct Key {
+        glm::vec3 pos;
+        uint32_t nrm, uv, clr;
+        bool operator==(const Key& o) const { return memcmp(this, &o, sizeof(Key)) == 0; } // Bitwise to match the hash
+    };
+    struct KeyHash {
+        size_t operator()(const Key& k) const { return (size_t)Utils::HashBytes(&k, sizeof(Key)); }
+    };
+    std::unordered_map<Key, uint32_t, KeyHash> welded;
+    welded.reserve(oldCount);
+    std::vector<uint32_t> remap(oldCount);
+    std::vector<glm::vec3> newVertices;
+    newVertices.reserve(oldCount);
+    for (size_t i = 0; i < oldCount; i++) {
+        const Key key = {
+            .pos = vertices[i],
+            .nrm = hasNormals ? nrm[i] : 0,
+            .uv = hasUVs ? uv[i] : 0,
+            .clr = hasColors ? clr[i] : 0
+        };
+        auto [it, inserted] = welded.try_emplace(key, (uint32_t)newVertices.size());
+        if (inserted) {
+            newVertices.push_back(vertices[i]);
+            if (hasNormals) packedNormals.push_back(nrm[i]);
+            if (hasUVs) packedUVs.push_back(uv[i]);
+            if (hasColors) packedColors.push_back(clr[i]);
+        }
+        remap[i] = it->second;
+    }
+
+    concurrency::parallel_for(size_t(0), triangles.size(), [&](size_t i) {
+        triangles[i] = remap[triangles[i]];
+    });
+
+    vertices = std::move(newVertices);
+    vertices.shrink_to_fit();
+    std::vector<glm::vec3>().swap(normals);
+    std::vector<glm::vec2>().swap(uvs);
+    std::vector<glm::vec4>().swap(colors);
+    ClearAdjacency();
+    compact = true;
+
+    const size_t newBytes = vertices.size() * sizeof(glm::vec3) + (packedNormals.size() + packedUVs.size() + packedColors.size()) * sizeof(uint32_t);
+    fmt::println("Compacted mesh, {} -> {} vertices, {}kb -> {}kb", oldCount, vertices.size(), oldBytes / 1024, newBytes / 1024);
 }
 
 void Mesh::ScaleVertices(const float& scale) {
@@ -276,6 +481,99 @@ void Mesh::OffsetVertices(const glm::vec3& offset) {
         vertices.data()[i] = vertices.data()[i] + offset;
 }
 
+// Raw array dumps, sizes first so reading can allocate once and read straight into place
+template <typename T>
+static void WriteArray(std::ostream& os, const std::vector<T>& vec) {
+    const uint64_t count = vec.size();
+    os.write((const char*)&count, sizeof(uint64_t));
+    os.write((const char*)vec.data(), count * sizeof(T));
+}
+
+// Bytes left in the stream, sizes read from a file are checked against this before allocating anything
+static uint64_t RemainingBytes(std::istream& is) {
+    const auto pos = is.tellg();
+    is.seekg(0, std::ios::end);
+    const auto end = is.tellg();
+    is.seekg(pos);
+    return pos < 0 || end < pos ? 0 : (uint64_t)(end - pos);
+}
+
+template <typename T>
+static bool ReadArray(std::istream& is, std::vector<T>& vec) {
+    uint64_t count = 0;
+    is.read((char*)&count, sizeof(uint64_t));
+    if (!is || count > RemainingBytes(is) / sizeof(T)) return false;
+    vec.resize(count);
+    is.read((char*)vec.data(), count * sizeof(T));
+    return (bool)is;
+}
+
+static void WriteString(std::ostream& os, const std::string& str) {
+    const uint32_t length = (uint32_t)str.size();
+    os.write((const char*)&length, sizeof(uint32_t));
+    os.write(str.data(), length);
+}
+
+static bool ReadString(std::istream& is, std::string& str) {
+    uint32_t length = 0;
+    is.read((char*)&length, sizeof(uint32_t));
+    if (!is || length > RemainingBytes(is)) return false;
+    str.resize(length);
+    is.read(str.data(), length);
+    return (bool)is;
+}
+
+void Mesh::WriteBinary(std::ostream& os) const {
+    WriteArray(os, vertices);
+    WriteArray(os, triangles);
+    WriteArray(os, uvs);
+    WriteArray(os, normals);
+    WriteArray(os, colors);
+    WriteArray(os, materialIDs);
+
+    const uint32_t materialCount = (uint32_t)materialMetadata.size();
+    os.write((const char*)&materialCount, sizeof(uint32_t));
+    for (const auto& mat : materialMetadata) {
+        WriteString(os, mat.materialName);
+        WriteString(os, mat.textureFilename);
+    }
+
+    const uint8_t flags = (hasColors ? 1 : 0) | (hasNormals ? 2 : 0) | (hasUVs ? 4 : 0);
+    os.write((const char*)&flags, sizeof(uint8_t));
+    os.write((const char*)&numUniqueMaterials, sizeof(int));
+}
+
+bool Mesh::ReadBinary(std::istream& is) {
+    Clear();
+
+    if (!ReadArray(is, vertices) || !ReadArray(is, triangles) || !ReadArray(is, uvs) ||
+        !ReadArray(is, normals) || !ReadArray(is, colors) || !ReadArray(is, materialIDs))
+        return false;
+
+    // Every material is at least 2 string lengths
+    uint32_t materialCount = 0;
+    is.read((char*)&materialCount, sizeof(uint32_t));
+    if (!is || materialCount > RemainingBytes(is) / (2 * sizeof(uint32_t))) return false;
+    materialMetadata.resize(materialCount);
+    for (auto& mat : materialMetadata)
+        if (!ReadString(is, mat.materialName) || !ReadString(is, mat.textureFilename)) return false;
+
+    uint8_t flags = 0;
+    is.read((char*)&flags, sizeof(uint8_t));
+    is.read((char*)&numUniqueMaterials, sizeof(int));
+    if (!is) return false;
+    hasColors = flags & 1;
+    hasNormals = flags & 2;
+    hasUVs = flags & 4;
+
+    // Same checks as CheckData() but a bad cache is just reparsed instead of exiting
+    if (vertices.size() != uvs.size() || uvs.size() != colors.size() || colors.size() != normals.size()) return false;
+    for (uint32_t index : triangles)
+        if (index >= vertices.size()) return false;
+
+    return true;
+}
+
 void Mesh::CopyFrom(const Mesh& other) {
     vertices = other.vertices;
     triangles = other.triangles;
@@ -283,6 +581,10 @@ void Mesh::CopyFrom(const Mesh& other) {
     uvs = other.uvs;
     normals = other.normals;
     materialIDs = other.materialIDs;
+    packedNormals = other.packedNormals;
+    packedUVs = other.packedUVs;
+    packedColors = other.packedColors;
+    compact = other.compact;
     hasNormals = other.hasNormals;
     hasColors = other.hasColors;
     hasUVs = other.hasUVs;
@@ -1,9 +1,15 @@
 #pragma once
 
 #include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
 #include <ufbx/ufbx.h>
 
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <span>
 #include <vector>
+#include <iosfwd>
 #include <filesystem>
 
 // A triangle based mesh
@@ -11,7 +17,20 @@ class Mesh {
 
     ufbx_scene* scene = nullptr;
 
-    int ReadNode(int i, int vertexOffset = 0);
+    // Every non-root node with a mesh, in scene order
+    std::vector<ufbx_node*> GetMeshNodes() const;
+
+    // Triangles a node turns into after quad splitting and ignored materials
+    size_t CountNodeTriangles(const ufbx_node* node) const;
+
+    // Material index of a face, 0 if the mesh has none
+    int GetFaceMaterial(const ufbx_mesh* mesh, size_t face) const;
+
+    // Reads nodes in parallel into one merged mesh
+    void ReadNodes(const std::vector<ufbx_node*>& nodes);
+
+    // Converts a node into the already sized arrays starting at given offsets
+    void ReadNode(const ufbx_node* node, size_t vertexOffset, size_t triOffset);
     
     void CheckData();
 
@@ -20,6 +39,17 @@ class Mesh {
 public:
     Mesh() = default;
 
+    // Compressed sparse rows, items of row i are in [offsets[i], offsets[i + 1])
+    struct Adjacency {
+        std::vector<uint32_t> offsets;
+        std::vector<uint32_t> items;
+
+        std::span<const uint32_t> operator[](size_t i) const { return { items.data() + offsets[i], items.data() + offsets[i + 1] }; }
+        size_t size() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+        bool empty() const { return offsets.empty(); }
+        void clear() { offsets.clear(); items.clear(); }
+    };
+
     struct MaterialMetadata {
         std::string materialName;
         std::string textureFilename;
@@ -31,12 +61,41 @@ public:
     std::vector<glm::vec3> normals;
     std::vector<glm::vec4> colors;
     std::vector<int> materialIDs; // tri index -> material index
-    std::vector<std::vector<uint32_t>> connectivity; // vertex index -> triangle list
-    std::vector<std::vector<uint32_t>> triConnectivity; // triangle index -> neighbor triangles
     std::vector<MaterialMetadata> materialMetadata;
 
     bool hasColors = false, hasNormals = false, hasUVs = false;
 
+    // After Compact() the float streams above are emptied and these are used instead, streams the mesh doesn't have stay empty
+    bool compact = false;
+    std::vector<uint32_t> packedNormals; // Octahedral, 2x16 bit snorm
+    std::vector<uint32_t> packedUVs; // 2x half
+    std::vector<uint32_t> packedColors; // RGBA8
+
+    // Per vertex attributes regardless of storage, defaults if the stream doesn't exist
+    glm::vec3 GetNormal(uint32_t i) const {
+        if (!compact) return normals[i];
+        return packedNormals.empty() ? glm::vec3(0, 1, 0) : DecodeNormal(packedNormals[i]);
+    }
+    glm::vec2 GetUV(uint32_t i) const {
+        if (!compact) return uvs[i];
+        return packedUVs.empty() ? glm::vec2(0, 0) : glm::unpackHalf2x16(packedUVs[i]);
+    }
+    glm::vec4 GetColor(uint32_t i) const {
+        if (!compact) return colors[i];
+        return packedColors.empty() ? glm::vec4(1, 1, 1, 1) : glm::unpackUnorm4x8(packedColors[i]);
+    }
+
+    // Octahedral normal encoding, unit vector folded onto a square
+    static uint32_t EncodeNormal(const glm::vec3& n);
+    static glm::vec3 DecodeNormal(uint32_t packed) {
+        const glm::vec2 f = glm::unpackSnorm2x16(packed);
+        glm::vec3 n = glm::vec3(f.x, f.y, 1.0f - glm::abs(f.x) - glm::abs(f.y));
+        const float t = glm::max(-n.z, 0.0f);
+        n.x += n.x >= 0.0f ? -t : t;
+        n.y += n.y >= 0.0f ? -t : t;
+        return glm::normalize(n);
+    }
+
     std::vector<int> ignoreMaterials;
     int numUniqueMaterials = 0;
 
@@ -57,10 +116,29 @@ public:
 
     // Reads a single mesh node from the loaded fbx and creates a mesh from it
     void ReadSceneMeshNode(int nodeIndex);
+
+    // Reads every mesh node of the loaded fbx into its own mesh, nodes are read in parallel
+    std::vector<std::unique_ptr<Mesh>> ReadEachNode();
     
     // Returns the number of meshes in the loaded fbx scene
     int GetMeshNodeCount();
 
+    // Vertex index -> triangles using it, built on first call, safe to call from several threads
+    const Adjacency& GetVertexTriangles() const;
+
+    // Triangle index -> triangles sharing a vertex with it, built on first call, safe to call from several threads
+    const Adjacency& GetTriangleNeighbors() const;
+
+    // Area weighted smooth normals from the vertex -> triangle adjacency, for meshes that come without normals
+    void GenerateNormals();
+
+    // Bytes held by vertex, index and adjacency arrays
+    size_t MemoryUsage() const;
+
+    // Welds identical vertices and switches to the packed streams, drops streams the mesh doesn't have
+    // Roughly halves per vertex memory, normals lose a bit of precision and uvs get half float precision
+    void Compact();
+
     // Bakes rotation to loaded data
     void RotateVertices(const glm::quat& rotation);
     
@@ -70,6 +148,25 @@ public:
     // Bakes translation to loaded data
     void OffsetVertices(const glm::vec3& offset);
     
+    // Writes the processed mesh data as one binary blob, skips ufbx parsing entirely on the next run
+    void WriteBinary(std::ostream& os) const;
+
+    // Reads a blob written by WriteBinary, returns false if the stream ended early or the data doesn't make sense
+    bool ReadBinary(std::istream& is);
+
     // Makes a copy of this mesh from other
     void CopyFrom(const Mesh& other);
+
+private:
+
+    // Lazily built adjacency, cleared with the mesh data
+    // Flags are checked without the lock, the build itself happens under it so only one thread does it
+    mutable Adjacency vertexTriangles;
+    mutable Adjacency triangleNeighbors;
+    mutable std::atomic<bool> vertexTrianglesBuilt = false;
+    mutable std::atomic<bool> triangleNeighborsBuilt = false;
+    mutable std::mutex adjacencyLock;
+
+    // Drops both adjacencies, not safe while another thread is reading them
+    void ClearAdjacency();
 };
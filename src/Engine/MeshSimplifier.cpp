@@ -0,0 +1,297 @@
+#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <fmt/core.h>
+
+// Symmetric 4x4 matrix, upper triangle only
+struct Quadric {
+	double m[10] = {};
+
+	Quadric() {}
+
+	// Plane ax + by + cz + d = 0
+	Quadric(double a, double b, double c, double d) {
+		m[0] = a * a; m[1] = a * b; m[2] = a * c; m[3] = a * d;
+		m[4] = b * b; m[5] = b * c; m[6] = b * d;
+		m[7] = c * c; m[8] = c * d;
+		m[9] = d * d;
+	}
+
+	Quadric operator+(const Quadric& o) const {
+		Quadric q;
+		for (int i = 0; i < 10; i++) q.m[i] = m[i] + o.m[i];
+		return q;
+	}
+
+	double Det(int a11, int a12, int a13, int a21, int a22, int a23, int a31, int a32, int a33) const {
+		return m[a11] * m[a22] * m[a33] + m[a13] * m[a21] * m[a32] + m[a12] * m[a23] * m[a31]
+			- m[a13] * m[a22] * m[a31] - m[a11] * m[a23] * m[a32] - m[a12] * m[a21] * m[a33];
+	}
+
+	// vT Q v
+	double Error(const glm::dvec3& p) const {
+		const double x = p.x, y = p.y, z = p.z;
+		return m[0] * x * x + 2 * m[1] * x * y + 2 * m[2] * x * z + 2 * m[3] * x + m[4] * y * y
+			+ 2 * m[5] * y * z + 2 * m[6] * y + m[7] * z * z + 2 * m[8] * z + m[9];
+	}
+};
+
+struct SimplifyTri {
+	uint32_t v[3];
+	double err[4]; // Per edge collapse cost, [3] = cheapest
+	glm::dvec3 n;
+	int material;
+	bool deleted = false, dirty = false;
+};
+
+struct SimplifyVert {
+	glm::dvec3 p;
+	Quadric q;
+	uint32_t refStart = 0, refCount = 0;
+	bool border = false;
+};
+
+struct SimplifyRef {
+	uint32_t tri, corner;
+};
+
+// Working state, mostly follows the well known "fast quadric mesh simplification" loop
+struct Simplifier {
+	std::vector<SimplifyTri> tris;
+	std::vector<SimplifyVert> verts;
+	std::vector<SimplifyRef> refs;
+
+	// Cost of collapsing v1 into v2 and where the merged vertex goes
+	double CollapseError(uint32_t i1, uint32_t i2, glm::dvec3& result) const {
+		const Quadric q = verts[i1].q + verts[i2].q;
+		const double det = q.Det(0, 1, 2, 1, 4, 5, 2, 5, 7);
+		if (det != 0.0) {
+			result.x = -1.0 / det * q.Det(1, 2, 3, 4, 5, 6, 5, 7, 8);
+			result.y = 1.0 / det * q.Det(0, 2, 3, 1, 5, 6, 2, 7, 8);
+			result.z = -1.0 / det * q.Det(0, 1, 3, 1, 4, 6, 2, 5, 8);
+			return q.Error(result);
+		}
+
+		// Singular, best of the ends and the midpoint
+		const glm::dvec3 p1 = verts[i1].p, p2 = verts[i2].p, p3 = (p1 + p2) * 0.5;
+		const double e1 = q.Error(p1), e2 = q.Error(p2), e3 = q.Error(p3);
+		const double err = glm::min(e1, glm::min(e2, e3));
+		result = err == e1 ? p1 : err == e2 ? p2 : p3;
+		return err;
+	}
+
+	void UpdateTriError(SimplifyTri& t) {
+		glm::dvec3 p;
+		for (int j = 0; j < 3; j++) t.err[j] = CollapseError(t.v[j], t.v[(j + 1) % 3], p);
+		t.err[3] = glm::min(t.err[0], glm::min(t.err[1], t.err[2]));
+	}
+
+	// Would moving v0 to p flip or degenerate any of its triangles? Marks the ones that collapse along with the edge
+	bool Flipped(const glm::dvec3& p, uint32_t i1, const SimplifyVert& v0, std::vector<char>& collapsing) const {
+		for (uint32_t k = 0; k < v0.refCount; k++) {
+			const SimplifyRef& ref = refs[v0.refStart + k];
+			const SimplifyTri& t = tris[ref.tri];
+			if (t.deleted) continue;
+
+			const uint32_t id1 = t.v[(ref.corner + 1) % 3], id2 = t.v[(ref.corner + 2) % 3];
+			if (id1 == i1 || id2 == i1) { collapsing[k] = 1; continue; }
+			collapsing[k] = 0;
+
+			const glm::dvec3 d1 = glm::normalize(verts[id1].p - p), d2 = glm::normalize(verts[id2].p - p);
+			if (glm::abs(glm::dot(d1, d2)) > 0.999) return true;
+			const glm::dvec3 n = glm::normalize(glm::cross(d1, d2));
+			if (glm::dot(n, t.n) < 0.2) return true;
+		}
+		return false;
+	}
+
+	// Points v's surviving triangles to i0 and appends their refs for i0's new list
+	void UpdateTris(uint32_t i0, const SimplifyVert& v, const std::vector<char>& collapsing, size_t& deletedTris) {
+		for (uint32_t k = 0; k < v.refCount; k++) {
+			const SimplifyRef ref = refs[v.refStart + k];
+			SimplifyTri& t = tris[ref.tri];
+			if (t.deleted) continue;
+			if (collapsing[k]) {
+				t.deleted = true;
+				deletedTris++;
+				continue;
+			}
+			t.v[ref.corner] = i0;
+			t.dirty = true;
+			UpdateTriError(t);
+			refs.push_back(ref);
+		}
+	}
+
+	// Drops deleted tris and rebuilds the vertex -> tri refs, first call also sets up quadrics and borders
+	void Rebuild(bool first) {
+		if (!first) std::erase_if(tris, [](const SimplifyTri& t) { return t.deleted; });
+
+		for (auto& v : verts) v.refStart = v.refCount = 0;
+		for (const auto& t : tris)
+			for (int j = 0; j < 3; j++) verts[t.v[j]].refCount++;
+		uint32_t start = 0;
+		for (auto& v : verts) {
+			v.refStart = start;
+			start += v.refCount;
+			v.refCount = 0;
+		}
+		refs.resize(start);
+		for (uint32_t i = 0; i < tris.size(); i++)
+			for (uint32_t j = 0; j < 3; j++) {
+				SimplifyVert& v = verts[tris[i].v[j]];
+				refs[v.refStart + v.refCount++] = SimplifyRef{ i, j };
+			}
+
+		if (!first) return;
+
+		// Plane quadrics of every tri summed to its corners
+		for (auto& t : tris) {
+			const glm::dvec3 p0 = verts[t.v[0]].p;
+			t.n = glm::normalize(glm::cross(verts[t.v[1]].p - p0, verts[t.v[2]].p - p0));
+			if (std::isnan(t.n.x)) t.n = glm::dvec3(0, 1, 0); // Degenerate
+			const Quadric q(t.n.x, t.n.y, t.n.z, -glm::dot(t.n, p0));
+			for (int j = 0; j < 3; j++) verts[t.v[j]].q = verts[t.v[j]].q + q;
+		}
+		for (auto& t : tris) UpdateTriError(t);
+
+		// Border vertices have a neighbour they share only 1 tri with
+		std::vector<uint32_t> ids, counts;
+		for (uint32_t i = 0; i < verts.size(); i++) {
+			ids.clear();
+			counts.clear();
+			const SimplifyVert& v = verts[i];
+			for (uint32_t k = 0; k < v.refCount; k++) {
+				const SimplifyTri& t = tris[refs[v.refStart + k].tri];
+				for (int j = 0; j < 3; j++) {
+					size_t ofs = 0;
+					while (ofs < ids.size() && ids[ofs] != t.v[j]) ofs++;
+					if (ofs == ids.size()) { ids.push_back(t.v[j]); counts.push_back(1); }
+					else counts[ofs]++;
+				}
+			}
+			for (size_t j = 0; j < ids.size(); j++)
+				if (counts[j] == 1) verts[ids[j]].border = true;
+		}
+	}
+};
+
+std::unique_ptr<Mesh> MeshSimplifier::Simplify(const Mesh& mesh, size_t targetTris) {
+
+	Simplifier s;
+
+	// Work in a unit box so the error thresholds don't depend on model scale
+	glm::vec3 lo = mesh.vertices.empty() ? glm::vec3(0.0f) : mesh.vertices[0], hi = lo;
+	for (const auto& v : mesh.vertices) { lo = glm::min(lo, v); hi = glm::max(hi, v); }
+	const glm::dvec3 center = (glm::dvec3(lo) + glm::dvec3(hi)) * 0.5;
+	const glm::vec3 size = hi - lo;
+	const double extent = glm::max((double)glm::max(size.x, glm::max(size.y, size.z)), 1e-9);
+
+	s.verts.resize(mesh.vertices.size());
+	for (size_t i = 0; i < mesh.vertices.size(); i++)
+		s.verts[i].p = (glm::dvec3(mesh.vertices[i]) - center) / extent;
+	s.tris.resize(mesh.triangles.size() / 3);
+	for (size_t i = 0; i < s.tris.size(); i++) {
+		for (int j = 0; j < 3; j++) s.tris[i].v[j] = mesh.triangles[i * 3 + j];
+		s.tris[i].material = mesh.materialIDs.empty() ? 0 : mesh.materialIDs[i];
+	}
+
+	// Collapse everything under a threshold that grows each iteration until we're at the target
+	constexpr int MAX_ITERATIONS = 100;
+	constexpr double AGGRESSIVENESS = 7.0;
+	const size_t startTris = s.tris.size();
+	size_t deletedTris = 0;
+	std::vector<char> collapsing0, collapsing1;
+
+	for (int iteration = 0; iteration < MAX_ITERATIONS; iteration++) {
+		if (startTris - deletedTris <= targetTris) break;
+
+		// Refs grow with every collapse, compact them every now and then, deletedTris keeps counting from the start
+		if (iteration % 5 == 0) s.Rebuild(iteration == 0);
+
+		for (auto& t : s.tris) t.dirty = false;
+		const double threshold = 1e-9 * std::pow((double)(iteration + 3), AGGRESSIVENESS);
+
+		for (size_t ti = 0; ti < s.tris.size(); ti++) {
+			SimplifyTri& t = s.tris[ti];
+			if (t.err[3] > threshold || t.deleted || t.dirty) continue;
+
+			for (int j = 0; j < 3; j++) {
+				if (t.err[j] > threshold) continue;
+
+				const uint32_t i0 = t.v[j], i1 = t.v[(j + 1) % 3];
+				SimplifyVert& v0 = s.verts[i0];
+				const SimplifyVert& v1 = s.verts[i1];
+				if (v0.border || v1.border) continue;
+
+				glm::dvec3 p;
+				s.CollapseError(i0, i1, p);
+				collapsing0.resize(v0.refCount);
+				collapsing1.resize(v1.refCount);
+				if (s.Flipped(p, i1, v0, collapsing0)) continue;
+				if (s.Flipped(p, i0, v1, collapsing1)) continue;
+
+				// Collapse i1 into i0, surviving tris of both get appended as i0's new ref list
+				v0.p = p;
+				v0.q = v0.q + v1.q;
+				const size_t refStart = s.refs.size();
+				s.UpdateTris(i0, v0, collapsing0, deletedTris);
+				s.UpdateTris(i0, s.verts[i1], collapsing1, deletedTris);
+				const size_t refCount = s.refs.size() - refStart;
+				SimplifyVert& nv0 = s.verts[i0];
+				if (refCount <= nv0.refCount) {
+					std::copy(s.refs.begin() + refStart, s.refs.end(), s.refs.begin() + nv0.refStart);
+					s.refs.resize(refStart);
+				}
+				else nv0.refStart = (uint32_t)refStart;
+				nv0.refCount = (uint32_t)refCount;
+				break;
+			}
+
+			if (startTris - deletedTris <= targetTris) break;
+		}
+	}
+
+	// Copy out the surviving tris, only vertices still in use
+	auto ret = std::make_unique<Mesh>();
+	ret->materialMetadata = mesh.materialMetadata;
+	ret->hasColors = mesh.hasColors;
+	ret->hasNormals = mesh.hasNormals;
+	ret->hasUVs = mesh.hasUVs;
+	ret->numUniqueMaterials = mesh.numUniqueMaterials;
+
+	std::vector<uint32_t> remap(s.verts.size(), UINT32_MAX);
+	for (const auto& t : s.tris) {
+		if (t.deleted) continue;
+		for (int j = 0; j < 3; j++) {
+			uint32_t& idx = remap[t.v[j]];
+			if (idx == UINT32_MAX) {
+				idx = (uint32_t)ret->vertices.size();
+				ret->vertices.push_back(glm::vec3(s.verts[t.v[j]].p * extent + center));
+				ret->normals.push_back(mesh.GetNormal(t.v[j]));
+				ret->uvs.push_back(mesh.GetUV(t.v[j]));
+				ret->colors.push_back(mesh.GetColor(t.v[j]));
+			}
+			ret->triangles.push_back(idx);
+		}
+		ret->materialIDs.push_back(t.material);
+	}
+
+	if (mesh.compact) ret->Compact();
+
+	fmt::println("Simplified mesh {} -> {} triangles", startTris, ret->triangles.size() / 3);
+	return ret;
+}
+
+float MeshSimplifier::AverageEdgeLength(const Mesh& mesh) {
+	double total = 0.0;
+	for (size_t i = 0; i + 2 < mesh.triangles.size(); i += 3) {
+		const glm::vec3& a = mesh.vertices[mesh.triangles[i + 0]];
+		const glm::vec3& b = mesh.vertices[mesh.triangles[i + 1]];
+		const glm::vec3& c = mesh.vertices[mesh.triangles[i + 2]];
+		total += glm::distance(a, b) + glm::distance(b, c) + glm::distance(c, a);
+	}
+	return mesh.triangles.empty() ? 0.0f : (float)(total / (double)mesh.triangles.size());
+}
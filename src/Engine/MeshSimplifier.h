@@ -0,0 +1,19 @@
+#pragma once
+
+#include <memory>
+
+#include "Engine/Mesh.h"
+
+// Quadric error metric edge collapse simplification (Garland & Heckbert)
+// Open borders (uv seams, holes) are locked so split vertices don't tear apart, collapses that flip triangles are skipped
+class MeshSimplifier {
+	MeshSimplifier() {}
+public:
+
+	// Returns a copy of mesh reduced to roughly targetTris triangles, collapsed vertices keep the attributes of the one that stayed
+	// Stops early if nothing cheap enough is left to collapse
+	static std::unique_ptr<Mesh> Simplify(const Mesh& mesh, size_t targetTris);
+
+	// Average edge length in mesh units, used for picking lods
+	static float AverageEdgeLength(const Mesh& mesh);
+};
@@ -0,0 +1,28 @@
+#include "TaskGraph.h"
+
+TaskGraph::Node TaskGraph::Add(std::function<void()> job, std::span<const Node> deps) {
+	const Node node = (Node)nodes.size();
+	auto& data = nodes.emplace_back();
+	data.job = std::move(job);
+	data.numDeps = (int)deps.size();
+	for (Node dep : deps) nodes[dep].dependents.push_back(node);
+	return node;
+}
+
+void TaskGraph::Run() {
+	for (auto& node : nodes) node.remaining = node.numDeps;
+
+	// Roots first, everything else gets scheduled by whichever of its dependencies finishes last
+	for (Node node = 0; node < (Node)nodes.size(); node++)
+		if (nodes[node].numDeps == 0) Schedule(node);
+
+	tasks.wait();
+}
+
+void TaskGraph::Schedule(Node node) {
+	tasks.run([this, node]() {
+		nodes[node].job();
+		for (Node dependent : nodes[node].dependents)
+			if (--nodes[dependent].remaining == 0) Schedule(dependent);
+	});
+}
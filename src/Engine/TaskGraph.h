@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <span>
+#include <vector>
+#include <ppl.h> // Task group
+
+// Jobs with dependencies, every job is started on a task group as soon as the jobs it depends on have finished
+// Jobs are free to parallel_for internally, idle cores steal from whatever is running instead of waiting at a pass barrier
+class TaskGraph {
+public:
+
+	using Node = int;
+
+	// Adds a job that runs once every node in deps has finished, deps have to be added before the job
+	Node Add(std::function<void()> job, std::span<const Node> deps = {});
+	Node Add(std::function<void()> job, std::initializer_list<Node> deps) { return Add(std::move(job), std::span<const Node>(deps.begin(), deps.size())); }
+
+	// Runs every job and blocks until all of them are done
+	void Run();
+
+	// Drops all jobs
+	void Clear() { nodes.clear(); }
+
+	size_t Count() const { return nodes.size(); }
+
+private:
+
+	struct NodeData {
+		std::function<void()> job;
+		std::vector<Node> dependents;
+		int numDeps = 0;
+		std::atomic<int> remaining = 0;
+	};
+
+	// Starts node on the task group, it schedules its dependents when done
+	void Schedule(Node node);
+
+	std::deque<NodeData> nodes; // Deque so nodes don't move, atomics can't
+	concurrency::task_group tasks;
+};
@@ -1,5 +1,13 @@
 #include "Texture.h"
 
+#include <bit>
+#include <fstream>
+#include <ppl.h> // Parallel for
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
 // stbi library spams compiler warnings due to some black magic it does
 #pragma warning(push)
 #pragma warning(disable : 26451; disable : 26819; disable : 6262; disable : 26450; disable : 6001)
@@ -12,18 +20,210 @@
 
 #include "Log.h"
 
+Texture::Filter Texture::filter = Texture::Filter::Bilinear;
+
 bool Texture::Exists() const {
-	return data.size() != 0;
+	return data.size() != 0 || blocks.size() != 0;
+}
+
+// Spreads the lower 16 bits of v so there's a zero bit between each
+static uint32_t Part1By1(uint32_t v) {
+	v &= 0x0000FFFF;
+	v = (v | (v << 8)) & 0x00FF00FF;
+	v = (v | (v << 4)) & 0x0F0F0F0F;
+	v = (v | (v << 2)) & 0x33333333;
+	v = (v | (v << 1)) & 0x55555555;
+	return v;
+}
+
+size_t Texture::TexelIndex(const MipLevel& mip, const glm::ivec2& pt) const {
+	switch (layout) {
+		case Layout::Tiled:
+			return mip.offset + ((size_t)((pt.y >> 2) * mip.stride + (pt.x >> 2)) << 4) + ((pt.y & 3) << 2) + (pt.x & 3);
+		case Layout::Morton: {
+			// Square morton blocks along the longer axis, only 1 of x/y has bits above mortonBits
+			const uint32_t low = (1u << mip.mortonBits) - 1;
+			const size_t block = (size_t)((pt.x | pt.y) >> mip.mortonBits) << (2 * mip.mortonBits);
+			return mip.offset + block + (Part1By1(pt.x & low) | (Part1By1(pt.y & low) << 1));
+		}
+		default:
+			return mip.offset + pt.x + (size_t)mip.size.x * pt.y;
+	}
+}
+
+Color Texture::Texel(const MipLevel& mip, const glm::ivec2& pt) const {
+	if (streamed) {
+		constexpr int P = TexturePages::PAGE_BLOCKS;
+		const int bx = pt.x >> 2, by = pt.y >> 2;
+		const TextureBlock::Bc1* page = TexturePages::Get(*this, mip.offset + (size_t)(by / P) * mip.stride + bx / P);
+		return TextureBlock::DecodeCached(page[(by % P) * P + bx % P], ((pt.y & 3) << 2) | (pt.x & 3));
+	}
+	if (compressed)
+		return TextureBlock::DecodeCached(blocks[mip.offset + (size_t)(pt.y >> 2) * mip.stride + (pt.x >> 2)], ((pt.y & 3) << 2) | (pt.x & 3));
+	return data[TexelIndex(mip, pt)];
 }
 
 Color Texture::SampleUVClamp(const glm::vec2& uv) const {
-	const glm::ivec2 pt = glm::clamp((glm::ivec2)(glm::fract(uv) * sizeF), glm::ivec2(0, 0), size);
-	return data[pt.x + size.x * pt.y];
+	const glm::ivec2 pt = glm::clamp((glm::ivec2)(glm::fract(uv) * sizeF), glm::ivec2(0, 0), size - 1);
+	return Texel(mips[0], pt);
 }
 
-Texture::Texture(const std::filesystem::path& path, bool flip) {
+int Texture::FootprintLevel(const float& footprint) const {
 
-	stbi_set_flip_vertically_on_load(flip);
+	// Footprint smaller than a texel = full res, skips the log for most close up samples
+	const float texels = footprint * glm::max(sizeF.x, sizeF.y);
+	if (texels <= 1.0f) return 0;
+
+	return (int)glm::log2(texels);
+}
+
+glm::vec4 Texture::Sample(const glm::vec2& uv, const float& footprint) const {
+	const int level = FootprintLevel(footprint);
+	if (filter == Filter::Bilinear) return SampleBilinearVec4(uv, level);
+	return SampleUVLevel(uv, level).ToVec4();
+}
+
+Color Texture::SampleUVLevel(const glm::vec2& uv, int level) const {
+	const MipLevel& mip = mips[glm::clamp(level, 0, (int)mips.size() - 1)];
+	const glm::ivec2 pt = glm::clamp((glm::ivec2)(glm::fract(uv) * mip.sizeF), glm::ivec2(0, 0), mip.size - 1);
+	return Texel(mip, pt);
+}
+
+glm::vec4 Texture::SampleBilinearVec4(const glm::vec2& uv, int level) const {
+	const MipLevel& mip = mips[glm::clamp(level, 0, (int)mips.size() - 1)];
+
+	// Texel centers are at +0.5, wraps so the blend goes over the edge like the uvs do
+	const glm::vec2 p = glm::fract(uv) * mip.sizeF - 0.5f;
+	const glm::vec2 fl = glm::floor(p);
+	const glm::vec2 f = p - fl;
+	const glm::ivec2 p0 = ((glm::ivec2)fl + mip.size) % mip.size;
+	const glm::ivec2 p1 = (p0 + 1) % mip.size;
+
+	const Color t00 = Texel(mip, p0);
+	const Color t10 = Texel(mip, glm::ivec2(p1.x, p0.y));
+	const Color t01 = Texel(mip, glm::ivec2(p0.x, p1.y));
+	const Color t11 = Texel(mip, p1);
+
+	// Weights of the 4 texels, 1/255 folded in
+	constexpr float div = 1.0f / 255.0f;
+	const float w00 = (1.0f - f.x) * (1.0f - f.y) * div, w10 = f.x * (1.0f - f.y) * div;
+	const float w01 = (1.0f - f.x) * f.y * div, w11 = f.x * f.y * div;
+
+#if defined(_M_X64) || defined(__SSE2__)
+	// Widen each RGBA8 texel to 4 floats and blend all channels at once, SSE2 only so it's on for every x64 build
+	auto load = [](const Color& c) {
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i bytes = _mm_cvtsi32_si128(std::bit_cast<int>(c));
+		return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(bytes, zero), zero));
+	};
+
+	__m128 sum = _mm_mul_ps(load(t00), _mm_set1_ps(w00));
+#if defined(__AVX2__)
+	sum = _mm_fmadd_ps(load(t10), _mm_set1_ps(w10), sum);
+	sum = _mm_fmadd_ps(load(t01), _mm_set1_ps(w01), sum);
+	sum = _mm_fmadd_ps(load(t11), _mm_set1_ps(w11), sum);
+#else
+	sum = _mm_add_ps(sum, _mm_mul_ps(load(t10), _mm_set1_ps(w10)));
+	sum = _mm_add_ps(sum, _mm_mul_ps(load(t01), _mm_set1_ps(w01)));
+	sum = _mm_add_ps(sum, _mm_mul_ps(load(t11), _mm_set1_ps(w11)));
+#endif
+
+	glm::vec4 ret;
+	_mm_storeu_ps(&ret.x, sum);
+	return ret;
+#else
+	return glm::vec4(t00.r, t00.g, t00.b, t00.a) * w00 + glm::vec4(t10.r, t10.g, t10.b, t10.a) * w10
+		+ glm::vec4(t01.r, t01.g, t01.b, t01.a) * w01 + glm::vec4(t11.r, t11.g, t11.b, t11.a) * w11;
+#endif
+}
+
+void Texture::GenerateMips() {
+
+	// Figure out the full chain first so data is only resized once
+	mips.clear();
+	mips.push_back(MipLevel{ .offset = 0, .size = size, .sizeF = sizeF, .stride = size.x, .mortonBits = 0 });
+	size_t total = (size_t)size.x * size.y;
+	while (mips.back().size.x > 1 || mips.back().size.y > 1) {
+		const glm::ivec2 next = glm::max(mips.back().size / 2, glm::ivec2(1));
+		mips.push_back(MipLevel{ .offset = total, .size = next, .sizeF = next, .stride = next.x, .mortonBits = 0 });
+		total += (size_t)next.x * next.y;
+	}
+	data.resize(total);
+
+	// Each level from the previous one, wrapping since uvs repeat
+	for (size_t i = 1; i < mips.size(); i++) {
+		const MipLevel& src = mips[i - 1];
+		const MipLevel& dst = mips[i];
+		stbir_resize(data.data() + src.offset, src.size.x, src.size.y, 0, data.data() + dst.offset, dst.size.x, dst.size.y, 0,
+			stbir_pixel_layout::STBIR_RGBA, stbir_datatype::STBIR_TYPE_UINT8, stbir_edge::STBIR_EDGE_WRAP, stbir_filter::STBIR_FILTER_BOX);
+	}
+}
+
+void Texture::ConvertLayout(Layout target) {
+
+	// Only converts from the linear rows stb hands us
+	if (target == layout || layout != Layout::Linear) return;
+
+	// New offsets + padded sizes per level
+	std::vector<MipLevel> newMips = mips;
+	size_t total = 0;
+	for (auto& mip : newMips) {
+		mip.offset = total;
+		if (target == Layout::Tiled) {
+			mip.stride = (mip.size.x + 3) / 4;
+			total += (size_t)mip.stride * ((mip.size.y + 3) / 4) * 16;
+		}
+		else if (target == Layout::Morton) {
+			const int w = (int)std::bit_ceil((uint32_t)mip.size.x), h = (int)std::bit_ceil((uint32_t)mip.size.y);
+			mip.mortonBits = std::countr_zero((uint32_t)glm::min(w, h));
+			total += (size_t)w * h;
+		}
+		else {
+			mip.stride = mip.size.x;
+			total += (size_t)mip.size.x * mip.size.y;
+		}
+	}
+
+	std::vector<Color> converted(total);
+	layout = target;
+	for (size_t i = 0; i < mips.size(); i++) {
+		for (int y = 0; y < mips[i].size.y; y++)
+			for (int x = 0; x < mips[i].size.x; x++)
+				converted[TexelIndex(newMips[i], glm::ivec2(x, y))] = data[mips[i].offset + x + (size_t)mips[i].size.x * y];
+	}
+
+	data = std::move(converted);
+	mips = std::move(newMips);
+}
+
+Texture::Texture(const Color& color) {
+	data = { color };
+	size = glm::ivec2(1, 1);
+	sizeF = size;
+	GenerateMips();
+}
+
+Texture::Texture(const std::filesystem::path& path, bool flip, Layout layout, bool compress, bool stream) {
+
+	static_assert(sizeof(Color) == 4); // Make sure no overflow if color struct changes
+
+	// Skip decoding + compressing entirely if we did it already
+	std::filesystem::path cachePath = path;
+	cachePath += ".bc1";
+	std::filesystem::path pagePath = path;
+	pagePath += ".pages";
+	if (stream && OpenPageFile(pagePath, path, flip)) {
+		fmt::println("Opened {}, Size {}x{}, {} mips, {} pages", pagePath.string(), size.x, size.y, mips.size(), pageCount);
+		return;
+	}
+	if (compress && !stream && ReadCompressedCache(cachePath, path, flip)) {
+		fmt::println("Read {}, Size {}x{}, {} mips, {}kb", cachePath.string(), size.x, size.y, mips.size(), MemoryUsage() / 1024);
+		return;
+	}
+	compress |= stream;
+
+	// Per thread flag since textures get loaded in parallel
+	stbi_set_flip_vertically_on_load_thread(flip);
 
 	int numChannels;
 	stbi_uc* img = stbi_load(path.string().c_str(), &size.x, &size.y, &numChannels, 4); // Request RGBA texture
@@ -31,13 +231,14 @@ Texture::Texture(const std::filesystem::path& path, bool flip) {
 	if (img == nullptr) LOG_FATAL_AND_EXIT_ARG("Failed to load img: ", stbi_failure_reason());
 	if (size.x == 0 || size.y == 0) LOG_FATAL_AND_EXIT("Zero size image?");
 
-	static_assert(sizeof(Color) == 4); // Make sure no overflow if color struct changes
-
+	// Compressed textures take 1/8th of the memory so they get to keep a lot more detail
 	constexpr int MAX_IMG_SIZE = 512;
+	constexpr int MAX_COMPRESSED_IMG_SIZE = 2048;
+	const int maxSize = compress ? MAX_COMPRESSED_IMG_SIZE : MAX_IMG_SIZE;
 
 	// Resize image
-	if (size.x > MAX_IMG_SIZE) {
-		double ratio = MAX_IMG_SIZE / (double)size.x;
+	if (size.x > maxSize) {
+		double ratio = maxSize / (double)size.x;
 		int newWidth = (int)(ratio * size.x), newHeight = (int)(ratio * size.y);
 
 		data.resize(newWidth * newHeight);
@@ -56,6 +257,246 @@ Texture::Texture(const std::filesystem::path& path, bool flip) {
 
 	stbi_image_free(img);
 
-	fmt::println("Read {}, Size {}x{}", path.string(), size.x, size.y);
+	GenerateMips();
+
+	// Blocks are 4x4 tiles already so layout doesn't apply to compressed textures
+	if (compress) {
+		Compress();
+		if (!stream) WriteCompressedCache(cachePath, flip);
+	}
+	else ConvertLayout(layout);
+
+	// Drop the blocks we just made and stream them back in like every later run would, stays resident if the file didn't work out
+	if (stream) {
+		WritePageFile(pagePath, flip);
+		std::vector<MipLevel> blockMips = mips;
+		if (OpenPageFile(pagePath, path, flip)) {
+			blocks.clear();
+			blocks.shrink_to_fit();
+		}
+		else mips = std::move(blockMips);
+	}
+
+	fmt::println("Read {}, Size {}x{}, {} mips, {}kb", path.string(), size.x, size.y, mips.size(), MemoryUsage() / 1024);
+}
+
+void Texture::Compress() {
+
+	// Blocks per level, partial blocks at the edges repeat the last row/column
+	std::vector<MipLevel> newMips = mips;
+	size_t total = 0;
+	for (auto& mip : newMips) {
+		mip.offset = total;
+		mip.stride = (mip.size.x + 3) / 4;
+		total += (size_t)mip.stride * ((mip.size.y + 3) / 4);
+	}
+	blocks.resize(total);
+
+	for (size_t i = 0; i < mips.size(); i++) {
+		const MipLevel& src = mips[i];
+		const MipLevel& dst = newMips[i];
+		concurrency::parallel_for(0, (src.size.y + 3) / 4, [&](int by) {
+			for (int bx = 0; bx < dst.stride; bx++) {
+				Color texels[16];
+				for (int j = 0; j < 4; j++) {
+					for (int k = 0; k < 4; k++) {
+						const int x = glm::min(bx * 4 + k, src.size.x - 1), y = glm::min(by * 4 + j, src.size.y - 1);
+						texels[j * 4 + k] = data[src.offset + x + (size_t)src.size.x * y];
+					}
+				}
+				blocks[dst.offset + (size_t)by * dst.stride + bx] = TextureBlock::Encode(texels);
+			}
+		});
+	}
+
+	mips = std::move(newMips);
+	compressed = true;
+	data.clear();
+	data.shrink_to_fit();
+}
+
+// Bump if the block format or file contents change
+static constexpr uint32_t COMPRESSED_CACHE_VERSION = 2;
+
+static uint64_t RemainingBytes(std::istream& is) {
+	const auto pos = is.tellg();
+	is.seekg(0, std::ios::end);
+	const auto end = is.tellg();
+	is.seekg(pos);
+	return pos < 0 || end < pos ? 0 : (uint64_t)(end - pos);
+}
+
+// Mip levels field by field so the files don't depend on struct padding, sizeF is rebuilt from size
+static constexpr size_t MIP_BYTES = sizeof(uint64_t) + 3 * sizeof(int32_t);
+
+static void WriteMips(std::ostream& os, const std::vector<Texture::MipLevel>& mips) {
+	const uint32_t mipCount = (uint32_t)mips.size();
+	os.write((const char*)&mipCount, sizeof(uint32_t));
+	for (const auto& mip : mips) {
+		const uint64_t offset = mip.offset;
+		const int32_t fields[3] = { mip.size.x, mip.size.y, mip.stride };
+		os.write((const char*)&offset, sizeof(uint64_t));
+		os.write((const char*)fields, sizeof(fields));
+	}
+}
+
+// Fails unless the sizes form the same chain GenerateMips makes for size, offsets/strides are up to the caller to check
+static bool ReadMips(std::istream& is, const glm::ivec2& size, std::vector<Texture::MipLevel>& mips) {
+	uint32_t mipCount = 0;
+	is.read((char*)&mipCount, sizeof(uint32_t));
+	if (!is || mipCount == 0 || mipCount > 32 || mipCount > RemainingBytes(is) / MIP_BYTES) return false;
+	if (size.x <= 0 || size.y <= 0) return false;
+
+	mips.resize(mipCount);
+	glm::ivec2 expected = size;
+	for (auto& mip : mips) {
+		uint64_t offset = 0;
+		int32_t fields[3] = {};
+		is.read((char*)&offset, sizeof(uint64_t));
+		is.read((char*)fields, sizeof(fields));
+		if (!is || fields[0] != expected.x || fields[1] != expected.y) return false;
+		mip = Texture::MipLevel{ .offset = (size_t)offset, .size = expected, .sizeF = expected, .stride = fields[2], .mortonBits = 0 };
+		expected = glm::max(expected / 2, glm::ivec2(1));
+	}
+	return mips.back().size == glm::ivec2(1, 1);
+}
+
+bool Texture::ReadCompressedCache(const std::filesystem::path& cachePath, const std::filesystem::path& sourcePath, bool flip) {
+
+	if (!std::filesystem::exists(cachePath)) return false;
+	if (std::filesystem::last_write_time(cachePath) < std::filesystem::last_write_time(sourcePath)) return false;
+
+	std::ifstream ifs(cachePath, std::ios::binary);
+	uint32_t version = 0;
+	bool cachedFlip = false;
+	ifs.read((char*)&version, sizeof(uint32_t));
+	ifs.read((char*)&cachedFlip, sizeof(bool));
+	if (!ifs || version != COMPRESSED_CACHE_VERSION || cachedFlip != flip) return false;
+
+	glm::ivec2 cachedSize;
+	std::vector<MipLevel> cachedMips;
+	ifs.read((char*)&cachedSize, sizeof(glm::ivec2));
+	if (!ifs || !ReadMips(ifs, cachedSize, cachedMips)) return false;
+
+	// Block ranges have to be back to back like Compress() lays them out, Texel() indexes with these as is
+	size_t total = 0;
+	for (const auto& mip : cachedMips) {
+		if (mip.offset != total || mip.stride != (mip.size.x + 3) / 4) return false;
+		total += (size_t)mip.stride * ((mip.size.y + 3) / 4);
+	}
+
+	uint64_t blockCount = 0;
+	ifs.read((char*)&blockCount, sizeof(uint64_t));
+	if (!ifs || blockCount != total || blockCount > RemainingBytes(ifs) / sizeof(TextureBlock::Bc1)) return false;
+	std::vector<TextureBlock::Bc1> cachedBlocks(blockCount);
+	ifs.read((char*)cachedBlocks.data(), blockCount * sizeof(TextureBlock::Bc1));
+	if (!ifs) return false;
+
+	size = cachedSize;
+	sizeF = size;
+	mips = std::move(cachedMips);
+	blocks = std::move(cachedBlocks);
+	compressed = true;
+	return true;
+}
+
+void Texture::WriteCompressedCache(const std::filesystem::path& cachePath, bool flip) const {
+	std::ofstream ofs(cachePath, std::ios::binary);
+	const uint64_t blockCount = blocks.size();
+	ofs.write((const char*)&COMPRESSED_CACHE_VERSION, sizeof(uint32_t));
+	ofs.write((const char*)&flip, sizeof(bool));
+	ofs.write((const char*)&size, sizeof(glm::ivec2));
+	WriteMips(ofs, mips);
+	ofs.write((const char*)&blockCount, sizeof(uint64_t));
+	ofs.write((const char*)blocks.data(), blockCount * sizeof(TextureBlock::Bc1));
+}
+
+Texture::~Texture() {
+	if (streamed) TexturePages::Release(*this);
+}
+
+// Bump if the page size or file contents change
+static constexpr uint32_t PAGE_FILE_VERSION = 2;
+
+bool Texture::OpenPageFile(const std::filesystem::path& pagePath, const std::filesystem::path& sourcePath, bool flip) {
+
+	if (!std::filesystem::exists(pagePath)) return false;
+	if (std::filesystem::last_write_time(pagePath) < std::filesystem::last_write_time(sourcePath)) return false;
+
+	std::ifstream ifs(pagePath, std::ios::binary);
+	uint32_t version = 0;
+	bool cachedFlip = false;
+	ifs.read((char*)&version, sizeof(uint32_t));
+	ifs.read((char*)&cachedFlip, sizeof(bool));
+	if (!ifs || version != PAGE_FILE_VERSION || cachedFlip != flip) return false;
+
+	glm::ivec2 pagedSize;
+	std::vector<MipLevel> pagedMips;
+	ifs.read((char*)&pagedSize, sizeof(glm::ivec2));
+	if (!ifs || !ReadMips(ifs, pagedSize, pagedMips)) return false;
+
+	// Page ranges have to be back to back like WritePageFile lays them out, Texel() indexes pages with these as is
+	constexpr int P = TexturePages::PAGE_BLOCKS;
+	size_t numPages = 0;
+	for (const auto& mip : pagedMips) {
+		const int pagesX = (((mip.size.x + 3) / 4) + P - 1) / P;
+		const int pagesY = (((mip.size.y + 3) / 4) + P - 1) / P;
+		if (mip.offset != numPages || mip.stride != pagesX) return false;
+		numPages += (size_t)pagesX * pagesY;
+	}
+
+	// Only the header is read, make sure the pages are actually there
+	const std::streamoff dataStart = ifs.tellg();
+	if (numPages > RemainingBytes(ifs) / TexturePages::PAGE_BYTES) return false;
+
+	size = pagedSize;
+	sizeF = size;
+	mips = std::move(pagedMips);
+	pageFile = pagePath;
+	pageDataStart = dataStart;
+	pageCount = numPages;
+	pages = std::make_unique<TexturePages::Slot[]>(pageCount);
+	compressed = true;
+	streamed = true;
+	return true;
 }
 
+void Texture::WritePageFile(const std::filesystem::path& pagePath, bool flip) const {
+	constexpr int P = TexturePages::PAGE_BLOCKS;
+
+	// Offset/stride in pages instead of blocks
+	std::vector<MipLevel> pagedMips = mips;
+	size_t total = 0;
+	for (auto& mip : pagedMips) {
+		const int pagesX = (mip.stride + P - 1) / P;
+		const int pagesY = (((mip.size.y + 3) / 4) + P - 1) / P;
+		mip.offset = total;
+		mip.stride = pagesX;
+		total += (size_t)pagesX * pagesY;
+	}
+
+	std::ofstream ofs(pagePath, std::ios::binary);
+	ofs.write((const char*)&PAGE_FILE_VERSION, sizeof(uint32_t));
+	ofs.write((const char*)&flip, sizeof(bool));
+	ofs.write((const char*)&size, sizeof(glm::ivec2));
+	WriteMips(ofs, pagedMips);
+
+	// Pages in order, blocks past the edge of the mip are transparent padding
+	const TextureBlock::Bc1 empty{ .c0 = 0, .c1 = 0, .indices = 0xFFFFFFFF };
+	TextureBlock::Bc1 page[P * P];
+	for (size_t i = 0; i < mips.size(); i++) {
+		const MipLevel& mip = mips[i];
+		const int blockRows = (mip.size.y + 3) / 4;
+		for (int py = 0; py < (blockRows + P - 1) / P; py++) {
+			for (int px = 0; px < pagedMips[i].stride; px++) {
+				for (int j = 0; j < P; j++) {
+					for (int k = 0; k < P; k++) {
+						const int bx = px * P + k, by = py * P + j;
+						page[j * P + k] = bx < mip.stride && by < blockRows ? blocks[mip.offset + (size_t)by * mip.stride + bx] : empty;
+					}
+				}
+				ofs.write((const char*)page, sizeof(page));
+			}
+		}
+	}
+}
@@ -2,18 +2,53 @@
 
 #include <glm/glm.hpp>
 #include <filesystem>
+#include <memory>
 #include <vector>
 
 #include "Engine/Common.h"
+#include "Engine/TextureBlock.h"
+#include "Engine/TexturePages.h"
 
 // Texture loaded as RGBA8
 class Texture {
 public:
 
-	// Data gets converted to standard Color vector on load
+	// How texels are ordered in memory, rays hit textures in all directions so non-linear layouts keep 2D neighbours closer
+	enum class Layout {
+		Linear, // Row major
+		Tiled, // 4x4 texel blocks (64 bytes, 1 cache line), blocks row major
+		Morton // Z-order curve, levels padded to power of 2
+	};
+
+	// Texture filtering used by Sample()
+	enum class Filter { Nearest, Bilinear };
+	static Filter filter;
+
+	// Data gets converted to standard Color vector on load, all mip levels are stored back to back with level 0 first
 	std::vector<Color> data;
 	glm::ivec2 size;
 	glm::vec2 sizeF;
+	Layout layout = Layout::Linear;
+
+	// Compressed textures keep blocks instead of data, per mip offset/stride are in blocks
+	std::vector<TextureBlock::Bc1> blocks;
+	bool compressed = false;
+
+	// Streamed textures only keep a page table, blocks are paged in from pageFile by TexturePages, per mip offset/stride are in pages
+	bool streamed = false;
+	std::unique_ptr<TexturePages::Slot[]> pages;
+	size_t pageCount = 0;
+	std::filesystem::path pageFile;
+	std::streamoff pageDataStart = 0;
+
+	struct MipLevel {
+		size_t offset; // Into data
+		glm::ivec2 size;
+		glm::vec2 sizeF;
+		int stride; // Tiled: blocks per row
+		int mortonBits; // Morton: bits per axis interleaved, the rest of the longer axis goes above them
+	};
+	std::vector<MipLevel> mips;
 
 	// Has anything been loaded?
 	bool Exists() const;
@@ -21,6 +56,53 @@ public:
 	// Samples this texture with the given UV coordinates
 	Color SampleUVClamp(const glm::vec2& uv) const;
 
+	// Samples a specific mip level
+	Color SampleUVLevel(const glm::vec2& uv, int level) const;
+
+	// Bilinearly samples a specific mip level, wraps at the edges. Stays in floats, blends with SSE2 on x64 (+ FMA with AVX2)
+	glm::vec4 SampleBilinearVec4(const glm::vec2& uv, int level) const;
+
+	// Samples the mip level matching footprint with the current filter mode, returns 0...1 color
+	glm::vec4 Sample(const glm::vec2& uv, const float& footprint) const;
+
+	// Bytes used by texel data, resident pages of streamed textures are counted by TexturePages instead
+	size_t MemoryUsage() const { return data.size() * sizeof(Color) + blocks.size() * sizeof(TextureBlock::Bc1) + pageCount * sizeof(TexturePages::Slot); }
+
 	// Loads a new texture from disk, optionally flips the Y
-	Texture(const std::filesystem::path& path, bool flip = false);
+	// Compressed textures are stored as BC1 blocks at a higher max res and cached to disk next to the source
+	// Streamed textures are compressed into a page file once and after that load nothing up front, pages are read when first sampled
+	Texture(const std::filesystem::path& path, bool flip = false, Layout layout = Layout::Linear, bool compress = false, bool stream = false);
+
+	// 1x1 texture of a single color
+	Texture(const Color& color);
+
+	~Texture();
+
+private:
+
+	// Mip level matching a uv footprint
+	int FootprintLevel(const float& footprint) const;
+
+	// Index of texel pt of given mip in data
+	size_t TexelIndex(const MipLevel& mip, const glm::ivec2& pt) const;
+
+	// Texel pt of given mip, decodes its block if compressed
+	Color Texel(const MipLevel& mip, const glm::ivec2& pt) const;
+
+	// Appends box filtered mip levels after level 0 down to 1x1
+	void GenerateMips();
+
+	// Reorders linear data to the given layout
+	void ConvertLayout(Layout target);
+
+	// Compresses linear data into blocks
+	void Compress();
+
+	// Compressed block cache on disk, read fails if it's missing, outdated or for a different flip
+	bool ReadCompressedCache(const std::filesystem::path& cachePath, const std::filesystem::path& sourcePath, bool flip);
+	void WriteCompressedCache(const std::filesystem::path& cachePath, bool flip) const;
+
+	// Page file of compressed blocks split into TexturePages::PAGE_BLOCKS sized squares, same rules as the compressed cache
+	bool OpenPageFile(const std::filesystem::path& pagePath, const std::filesystem::path& sourcePath, bool flip);
+	void WritePageFile(const std::filesystem::path& pagePath, bool flip) const;
 };
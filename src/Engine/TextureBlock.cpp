@@ -0,0 +1,119 @@
+#include "TextureBlock.h"
+
+#include <algorithm>
+#include <climits>
+
+std::atomic<uint32_t> TextureBlock::cacheGeneration = 0;
+
+// 565 <-> 888 conversions, expanded values replicate the top bits so white stays white
+static uint16_t To565(int r, int g, int b) {
+	return (uint16_t)(((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+}
+
+static Color From565(uint16_t c) {
+	const int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+	return Color{ .r = (uint8_t)((r << 3) | (r >> 2)), .g = (uint8_t)((g << 2) | (g >> 4)), .b = (uint8_t)((b << 3) | (b >> 2)), .a = 255 };
+}
+
+// Fills the 4 palette entries of a block
+static void Palette(const TextureBlock::Bc1& block, Color palette[4]) {
+	palette[0] = From565(block.c0);
+	palette[1] = From565(block.c1);
+	const Color& p0 = palette[0];
+	const Color& p1 = palette[1];
+
+	if (block.c0 > block.c1) {
+		// 4 color mode, 2 interpolated
+		palette[2] = Color{ .r = (uint8_t)((2 * p0.r + p1.r) / 3), .g = (uint8_t)((2 * p0.g + p1.g) / 3), .b = (uint8_t)((2 * p0.b + p1.b) / 3), .a = 255 };
+		palette[3] = Color{ .r = (uint8_t)((p0.r + 2 * p1.r) / 3), .g = (uint8_t)((p0.g + 2 * p1.g) / 3), .b = (uint8_t)((p0.b + 2 * p1.b) / 3), .a = 255 };
+	}
+	else {
+		// 3 color mode, midpoint + transparent
+		palette[2] = Color{ .r = (uint8_t)((p0.r + p1.r) / 2), .g = (uint8_t)((p0.g + p1.g) / 2), .b = (uint8_t)((p0.b + p1.b) / 2), .a = 255 };
+		palette[3] = Colors::Clear;
+	}
+}
+
+TextureBlock::Bc1 TextureBlock::Encode(const Color texels[16]) {
+
+	// Endpoints from the bounding box of opaque texels, inset a bit to reduce error on the extremes
+	int mn[3] = { 255, 255, 255 }, mx[3] = { 0, 0, 0 };
+	bool anyOpaque = false, anyTransparent = false;
+	for (int i = 0; i < 16; i++) {
+		const Color& c = texels[i];
+		if (c.a < 128) { anyTransparent = true; continue; }
+		anyOpaque = true;
+		mn[0] = std::min(mn[0], (int)c.r); mx[0] = std::max(mx[0], (int)c.r);
+		mn[1] = std::min(mn[1], (int)c.g); mx[1] = std::max(mx[1], (int)c.g);
+		mn[2] = std::min(mn[2], (int)c.b); mx[2] = std::max(mx[2], (int)c.b);
+	}
+
+	// Fully transparent block, 3 color mode with every index at the transparent entry
+	if (!anyOpaque) return Bc1{ .c0 = 0, .c1 = 0, .indices = 0xFFFFFFFF };
+
+	for (int i = 0; i < 3; i++) {
+		const int inset = (mx[i] - mn[i]) / 16;
+		mn[i] += inset;
+		mx[i] -= inset;
+	}
+
+	Bc1 block{ .c0 = To565(mx[0], mx[1], mx[2]), .c1 = To565(mn[0], mn[1], mn[2]), .indices = 0 };
+
+	// Endpoint order picks the mode, c0 > c1 = 4 colors, otherwise 3 colors + transparent
+	if (anyTransparent ? block.c0 > block.c1 : block.c0 < block.c1)
+		std::swap(block.c0, block.c1);
+
+	Color palette[4];
+	Palette(block, palette);
+
+	// Closest palette entry for every texel
+	const int opaqueEntries = block.c0 > block.c1 ? 4 : 3;
+	for (int i = 0; i < 16; i++) {
+		const Color& c = texels[i];
+		uint32_t best = 3;
+		if (c.a >= 128) {
+			int bestDist = INT_MAX;
+			for (int j = 0; j < opaqueEntries; j++) {
+				const int dr = c.r - palette[j].r, dg = c.g - palette[j].g, db = c.b - palette[j].b;
+				const int dist = dr * dr + dg * dg + db * db;
+				if (dist < bestDist) { bestDist = dist; best = j; }
+			}
+		}
+		block.indices |= best << (i * 2);
+	}
+
+	return block;
+}
+
+void TextureBlock::Decode(const Bc1& block, Color texels[16]) {
+	Color palette[4];
+	Palette(block, palette);
+	for (int i = 0; i < 16; i++)
+		texels[i] = palette[(block.indices >> (i * 2)) & 3];
+}
+
+Color TextureBlock::DecodeCached(const Bc1& block, int texel) {
+
+	// Direct mapped on the block's address, anything freeing blocks has to call InvalidateCaches
+	struct CachedBlock {
+		const Bc1* block = nullptr;
+		Color texels[16];
+	};
+	constexpr size_t CACHE_SIZE = 256;
+	thread_local CachedBlock cache[CACHE_SIZE];
+	thread_local uint32_t generation = 0;
+
+	// Block memory was freed since we last looked, start over
+	const uint32_t current = cacheGeneration.load(std::memory_order_relaxed);
+	if (generation != current) {
+		for (auto& entry : cache) entry.block = nullptr;
+		generation = current;
+	}
+
+	CachedBlock& entry = cache[((uintptr_t)&block / sizeof(Bc1)) & (CACHE_SIZE - 1)];
+	if (entry.block != &block) {
+		Decode(block, entry.texels);
+		entry.block = &block;
+	}
+	return entry.texels[texel];
+}
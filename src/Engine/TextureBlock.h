@@ -0,0 +1,36 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "Engine/Common.h"
+
+// BC1 style block compression for textures, 4x4 texels in 8 bytes (8:1 vs RGBA8)
+// 2 RGB565 endpoints + 2 bit palette index per texel
+// Blocks with any transparent texels use the 3 color + transparent mode so cutouts survive compression
+class TextureBlock {
+	TextureBlock() {}
+public:
+
+	struct Bc1 {
+		uint16_t c0, c1;
+		uint32_t indices; // 2 bits per texel, row major inside the block
+	};
+	static_assert(sizeof(Bc1) == 8);
+
+	// Encodes 16 texels (row major) into a block
+	static Bc1 Encode(const Color texels[16]);
+
+	// Decodes a block into 16 texels (row major)
+	static void Decode(const Bc1& block, Color texels[16]);
+
+	// Returns texel i of a block, recently decoded blocks are kept in a small per thread cache
+	// Ray traced samples tend to hit the same blocks repeatedly, so decoding the whole block once pays off
+	static Color DecodeCached(const Bc1& block, int texel);
+
+	// Invalidates every thread's decode cache, needed when block memory gets freed
+	static void InvalidateCaches() { cacheGeneration++; }
+
+private:
+	static std::atomic<uint32_t> cacheGeneration;
+};
@@ -0,0 +1,100 @@
+#include "TexturePages.h"
+
+#include <algorithm>
+#include <fstream>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "Engine/Texture.h"
+
+size_t TexturePages::memoryBudget = 256 * 1024 * 1024;
+std::atomic<size_t> TexturePages::residentBytes = 0;
+uint32_t TexturePages::frame = 0;
+
+// Loading is rare compared to sampling so a single lock around disk access + bookkeeping is fine
+static std::mutex loadMutex;
+static std::unordered_map<const Texture*, std::ifstream> files;
+
+struct ResidentPage {
+	const Texture* texture;
+	size_t page;
+};
+static std::vector<ResidentPage> resident;
+
+const TextureBlock::Bc1* TexturePages::Get(const Texture& texture, size_t page) {
+	Slot& slot = texture.pages[page];
+
+	TextureBlock::Bc1* blocks = slot.blocks.load(std::memory_order_acquire);
+	if (blocks == nullptr) blocks = Load(texture, page);
+
+	// Only write when it changes so hot pages don't bounce between cores
+	if (slot.lastUsed.load(std::memory_order_relaxed) != frame)
+		slot.lastUsed.store(frame, std::memory_order_relaxed);
+
+	return blocks;
+}
+
+TextureBlock::Bc1* TexturePages::Load(const Texture& texture, size_t page) {
+	std::lock_guard lock(loadMutex);
+
+	// Another thread might have loaded it while we waited
+	Slot& slot = texture.pages[page];
+	if (TextureBlock::Bc1* blocks = slot.blocks.load(std::memory_order_acquire)) return blocks;
+
+	auto& ifs = files[&texture];
+	if (!ifs.is_open()) ifs.open(texture.pageFile, std::ios::binary);
+
+	TextureBlock::Bc1* blocks = new TextureBlock::Bc1[PAGE_BLOCKS * PAGE_BLOCKS];
+	ifs.seekg(texture.pageDataStart + (std::streamoff)(page * PAGE_BYTES));
+	ifs.read((char*)blocks, PAGE_BYTES);
+	if (!ifs) {
+		// Shouldn't happen unless the file changed under us, show transparent instead of garbage
+		ifs.clear();
+		std::fill(blocks, blocks + PAGE_BLOCKS * PAGE_BLOCKS, TextureBlock::Bc1{ .c0 = 0, .c1 = 0, .indices = 0xFFFFFFFF });
+	}
+
+	slot.lastUsed.store(frame, std::memory_order_relaxed);
+	slot.blocks.store(blocks, std::memory_order_release);
+	resident.push_back(ResidentPage{ .texture = &texture, .page = page });
+	residentBytes += PAGE_BYTES;
+	return blocks;
+}
+
+void TexturePages::Trim() {
+	std::lock_guard lock(loadMutex);
+
+	frame++;
+
+	if (residentBytes <= memoryBudget) return;
+
+	// Oldest first
+	std::sort(resident.begin(), resident.end(), [](const ResidentPage& a, const ResidentPage& b) {
+		return a.texture->pages[a.page].lastUsed.load(std::memory_order_relaxed) < b.texture->pages[b.page].lastUsed.load(std::memory_order_relaxed);
+	});
+
+	size_t evicted = 0;
+	while (evicted < resident.size() && residentBytes > memoryBudget) {
+		Slot& slot = resident[evicted].texture->pages[resident[evicted].page];
+		delete[] slot.blocks.exchange(nullptr);
+		residentBytes -= PAGE_BYTES;
+		evicted++;
+	}
+	resident.erase(resident.begin(), resident.begin() + evicted);
+
+	// Freed pages can get reallocated for other pages, decoded blocks keyed by address would go stale
+	TextureBlock::InvalidateCaches();
+}
+
+void TexturePages::Release(const Texture& texture) {
+	std::lock_guard lock(loadMutex);
+
+	std::erase_if(resident, [&](const ResidentPage& p) {
+		if (p.texture != &texture) return false;
+		delete[] texture.pages[p.page].blocks.exchange(nullptr);
+		residentBytes -= PAGE_BYTES;
+		return true;
+	});
+	files.erase(&texture);
+	TextureBlock::InvalidateCaches();
+}
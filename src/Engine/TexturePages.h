@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "Engine/TextureBlock.h"
+
+class Texture; // Texture holds the page table so forward declare
+
+// Residency for streamed textures, pages of compressed blocks are read from the texture's page file the first time they're sampled
+// Resident pages are kept under a memory budget, least recently used get evicted between frames
+class TexturePages {
+	TexturePages() {}
+public:
+
+	// Page side in blocks, 16x16 blocks = 64x64 texels = 2kb
+	static constexpr int PAGE_BLOCKS = 16;
+	static constexpr size_t PAGE_BYTES = PAGE_BLOCKS * PAGE_BLOCKS * sizeof(TextureBlock::Bc1);
+
+	// Page table entry, null blocks = not resident
+	struct Slot {
+		std::atomic<TextureBlock::Bc1*> blocks = nullptr;
+		std::atomic<uint32_t> lastUsed = 0;
+	};
+
+	// Max bytes of resident pages, can go over during a frame and is enforced in Trim()
+	static size_t memoryBudget;
+
+	// Returns the blocks of a page, loading it from disk if it's not resident. Thread safe.
+	static const TextureBlock::Bc1* Get(const Texture& texture, size_t page);
+
+	// Evicts least recently used pages until under budget, must not be called while anything is sampling
+	static void Trim();
+
+	// Drops all pages of a texture
+	static void Release(const Texture& texture);
+
+	static size_t ResidentBytes() { return residentBytes; }
+
+private:
+
+	// Reads a page from disk, slow path of Get()
+	static TextureBlock::Bc1* Load(const Texture& texture, size_t page);
+
+	static std::atomic<size_t> residentBytes; // Changed under the page lock, read without it
+	static uint32_t frame;
+};
@@ -10,8 +10,20 @@ void Timer::Start() {
 }
 
 void Timer::End() {
+	Push(Time::GetAccurateTime() - current);
+}
+
+void Timer::Add() {
+	accumulated += Time::GetAccurateTime() - current;
+}
+
+void Timer::Commit() {
+	Push(accumulated);
+	accumulated = 0.0;
+}
+
+void Timer::Push(double delta) {
 	int count = std::max((int)times.size(), 1);
-	double delta = Time::GetAccurateTime() - current;
 	if (times.size() < times.capacity()) times.push_back(delta);
 	else times[(traceCnt++) % count] = delta;
 }
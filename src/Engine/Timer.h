@@ -6,6 +6,9 @@
 class Timer {
 	size_t traceCnt = 0;
 	double current = 0.0;
+	double accumulated = 0.0;
+
+	void Push(double delta);
 public:
 
 	std::vector<double> times;
@@ -15,5 +18,9 @@ public:
 
 	void Start();
 	void End();
+
+	// For things timed many times a frame, Add() sums up time since Start() and Commit() stores the sum as 1 sample
+	void Add();
+	void Commit();
 	double GetAveragedTime();
 };
@@ -196,6 +196,45 @@ bool Utils::HasFlag(const T& val, const T& flag) {
     return (val & flag) != 0;
 }
 
+uint32_t Utils::Morton3D(const glm::vec3& p) {
+
+    // Spreads the lower 10 bits of v so there's 2 zero bits between each
+    auto expandBits = [](uint32_t v) {
+        v = (v * 0x00010001u) & 0xFF0000FFu;
+        v = (v * 0x00000101u) & 0x0F00F00Fu;
+        v = (v * 0x00000011u) & 0xC30C30C3u;
+        v = (v * 0x00000005u) & 0x49249249u;
+        return v;
+    };
+
+    const glm::vec3 q = glm::clamp(p * 1024.0f, 0.0f, 1023.0f);
+    return (expandBits((uint32_t)q.x) << 2) | (expandBits((uint32_t)q.y) << 1) | expandBits((uint32_t)q.z);
+}
+
+uint64_t Utils::HashBytes(const void* data, size_t size, uint64_t seed) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+uint64_t Utils::HashFile(const std::filesystem::path& path) {
+    std::ifstream ifs(path, std::ios::binary);
+    if (!ifs) return 0;
+
+    // Chunked so big meshes don't need to fit in memory twice
+    std::vector<char> buffer(1 << 20);
+    uint64_t hash = 0xcbf29ce484222325ull;
+    while (ifs) {
+        ifs.read(buffer.data(), buffer.size());
+        hash = HashBytes(buffer.data(), (size_t)ifs.gcount(), hash);
+    }
+    return hash;
+}
+
 void Utils::PrintMatrix(const glm::mat4x4& matrix) {
     fmt::println("Matrix4x4:");
     fmt::println("({}, {}, {}, {})", Log::FormatFloat(matrix[0][0]), Log::FormatFloat(matrix[1][0]), Log::FormatFloat(matrix[2][0]), Log::FormatFloat(matrix[3][0]));
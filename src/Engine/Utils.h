@@ -78,6 +78,15 @@ namespace Utils {
     // 3 in, 2 out
     glm::vec2 Hash23(glm::vec3 p);
 
+    // Interleaves 10 bits of each 0...1 coordinate into a 30 bit morton code
+    uint32_t Morton3D(const glm::vec3& p);
+
+    // 64-bit FNV-1a of a block of memory, continues from seed
+    uint64_t HashBytes(const void* data, size_t size, uint64_t seed = 0xcbf29ce484222325ull);
+
+    // FNV-1a of a whole file's contents, 0 if it can't be read
+    uint64_t HashFile(const std::filesystem::path& path);
+
     // Constructs a model matrix from given params
     glm::mat4x4 ModelMatrix(const glm::vec3& pos, const glm::vec3& lookAtTarget, const glm::vec3& scale);
     
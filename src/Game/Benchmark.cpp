@@ -0,0 +1,124 @@
+#include "Benchmark.h"
+
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include <fmt/core.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "Engine/Time.h"
+#include "Engine/Assets.h"
+#include "Engine/MemoryStats.h"
+#include "Engine/TexturePages.h"
+#include "Game/Game.h"
+#include "Game/RenderedMesh.h"
+
+void Benchmark::Run(int width, int height, int frames) {
+
+	Game::raytracer.CreateHeadless(width, height);
+	Game::scene.ReadAndAddTestObjects();
+	AddStreamedAssets();
+	Assets::WaitForLoads(); // Measure the finished scene, not placeholders
+
+	// Same start view as the interactive mode, nothing moves during the benchmark
+	const auto camStartPos = glm::vec3(-1.5f, 3.7f, 5.6f);
+	Game::scene.camera = {
+		.transform = {
+			.position = camStartPos,
+			.rotation = glm::normalize(glm::quatLookAt(glm::normalize(camStartPos), glm::vec3(0,1,0))),
+			.scale = glm::vec3(1,1,1) },
+		.fov = 70.0f,
+		.nearClip = 0.05f,
+		.farClip = 1000.0f,
+	};
+	Game::scene.UpdateTransforms();
+
+	struct Config {
+		const char* name;
+		bool wavefront, sortRays;
+	};
+	const Config configs[] = {
+		{ "Recursive", false, false },
+		{ "Recursive, sorted indirect rays", false, true }, // Only the indirect pass sorts
+		{ "Wavefront", true, false },
+		{ "Wavefront, sorted rays", true, true },
+	};
+
+	auto& rt = Game::raytracer;
+
+	// Warmup so buffers are allocated and caches are hot, returns seconds per frame
+	auto measure = [&]() {
+		for (int i = 0; i < 4; i++) rt.RenderScene(Game::scene);
+
+		double start = Time::GetAccurateTime();
+		for (int i = 0; i < frames; i++) rt.RenderScene(Game::scene);
+		return (Time::GetAccurateTime() - start) / frames;
+	};
+
+	fmt::println("Benchmark {}x{}, {} frames per config", width, height, frames);
+
+	for (const auto& config : configs) {
+		rt.useWavefront = config.wavefront;
+		rt.sortRays = config.sortRays;
+
+		double frameTime = measure();
+
+		fmt::println("{}: frame {:.2f}ms | scene trace {:.2f}ms | shadows {:.2f}ms + {:.2f}ms | indirect {:.2f}ms + {:.2f}ms | ray sort {:.2f}ms/frame",
+			config.name, frameTime * 1000.0,
+			rt.sceneTraceTimer.GetAveragedTime() * 1000.0,
+			rt.lightBufferSampleTimer.GetAveragedTime() * 1000.0, rt.lightBufferGenTimer.GetAveragedTime() * 1000.0,
+			rt.indirectSampleTimer.GetAveragedTime() * 1000.0, rt.indirectGenTimer.GetAveragedTime() * 1000.0,
+			config.sortRays ? rt.raySortTimer.GetAveragedTime() * 1000.0 : 0.0);
+	}
+
+	// Separate run with an extra object so the configs above stay comparable between versions
+	AddStreamedAssets();
+	Assets::WaitForLoads();
+	Game::scene.UpdateTransforms();
+	rt.useWavefront = false;
+	rt.sortRays = false;
+	double frameTime = measure();
+	fmt::println("Recursive + streamed texture ball: frame {:.2f}ms | scene trace {:.2f}ms | texture pages resident {:.2f}MB",
+		frameTime * 1000.0, rt.sceneTraceTimer.GetAveragedTime() * 1000.0, TexturePages::ResidentBytes() / (1024.0 * 1024.0));
+
+	MemoryStats::Print();
+}
+
+// Checker with a gradient so every mip and page has something different in it, written once as a binary ppm stb can read
+static const std::filesystem::path BENCHMARK_TEXTURE = "models/benchmark_checker.ppm";
+
+static void WriteBenchmarkTexture() {
+	constexpr int size = 1024;
+	std::vector<uint8_t> rgb(size * size * 3);
+	for (int y = 0; y < size; y++) {
+		for (int x = 0; x < size; x++) {
+			const bool odd = ((x >> 5) ^ (y >> 5)) & 1;
+			uint8_t* px = &rgb[((size_t)y * size + x) * 3];
+			px[0] = (uint8_t)(x >> 2);
+			px[1] = (uint8_t)(y >> 2);
+			px[2] = odd ? 0xff : 0x20;
+		}
+	}
+
+	std::filesystem::create_directories(BENCHMARK_TEXTURE.parent_path());
+	std::ofstream ofs(BENCHMARK_TEXTURE, std::ios::binary);
+	const std::string header = fmt::format("P6\n{} {}\n255\n", size, size);
+	ofs.write(header.data(), header.size());
+	ofs.write((const char*)rgb.data(), rgb.size());
+}
+
+// Textured ball using a streamed texture, the page file is made on the first run and streamed from after that
+void Benchmark::AddStreamedAssets() {
+
+	if (!std::filesystem::exists(BENCHMARK_TEXTURE)) WriteBenchmarkTexture();
+
+	auto meshHandle = Assets::NewMesh(std::filesystem::path("models/triangleBall2.fbx"), Assets::ImportOpts{ .compactVertices = true });
+	auto rendMesh = std::make_unique<RenderedMesh>("streamed ball", meshHandle);
+	rendMesh->transform.scale = glm::vec3(1.5f);
+	rendMesh->transform.position += glm::vec3(3.0f, 1.5f, 3.0f);
+	rendMesh->materials[0].textureHandle = Assets::NewTextureAsync(BENCHMARK_TEXTURE, Assets::ImportOpts{ .flipY = true, .streamTexture = true });
+	rendMesh->SetShader(Shader::Textured);
+
+	Game::scene.entities.push_back(std::move(rendMesh));
+}
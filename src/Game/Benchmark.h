@@ -0,0 +1,16 @@
+#pragma once
+
+// Headless benchmark, renders the test scene from a fixed camera without a window and prints pass timings
+// Started with --benchmark
+class Benchmark {
+	Benchmark() {}
+public:
+
+	// Renders given amount of frames with every raytracer configuration and prints the averages
+	static void Run(int width, int height, int frames);
+
+private:
+
+	// Adds an object with a streamed texture for the last, separately timed run
+	static void AddStreamedAssets();
+};
@@ -7,4 +7,7 @@ struct Camera {
 	Transform transform;
 	float fov;
 	float nearClip, farClip;
+
+	// Angle between the rays of 2 adjacent pixels, starting spread of primary ray cones
+	float PixelSpread(int screenHeight) const { return 2.0f * glm::tan(glm::radians(fov) * 0.5f) / (float)screenHeight; }
 };
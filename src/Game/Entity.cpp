@@ -24,3 +24,9 @@ void Entity::SetShader(Shader shaderType) {
 			FragmentShader = &Shaders::PlainColor; break;
 	}
 }
+
+const Material& Entity::GetMaterial(int triIndex) const {
+	if (type == Entity::Type::RenderedMesh)
+		return materials[GetMesh()->materialIDs[triIndex / 3]];
+	return materials[0];
+}
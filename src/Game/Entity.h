@@ -34,6 +34,7 @@ public:
 	AABB aabb;
 	AABB worldAABB;
 	Bvh bvh;
+	std::vector<Bvh::ReflectionCache> reflectionCaches; // Per scene light, only used by meshes
 
 	// "Material" properties
 	int meshHandle = -1; // Mesh, if any
@@ -44,7 +45,21 @@ public:
 	std::vector<Material> materials;
 	bool HasMesh() const { return meshHandle >= 0; }
 
-	const Mesh* GetMesh() const { return Assets::Meshes[meshHandle].get(); }
+	// Simplified copies of the mesh, coarser each level, one gets picked per frame in Scene::UpdateTransforms
+	struct MeshLod {
+		int meshHandle;
+		Bvh bvh;
+		float edgeLength; // Average edge length in local units
+	};
+	std::vector<MeshLod> lods;
+	int activeLod = -1; // Index to lods, -1 = full mesh
+
+	// Mesh and bvh of the active lod, hits store tri indices of these
+	const Mesh* GetMesh() const { return Assets::Meshes[activeLod < 0 ? meshHandle : lods[activeLod].meshHandle].get(); }
+	const Bvh& GetBvh() const { return activeLod < 0 ? bvh : lods[activeLod].bvh; }
+
+	// Returns the material at given tri index for meshes, parametric shapes only have 1 material
+	const Material& GetMaterial(int triIndex) const;
 
 	// Fills v2f-style struct with relevant data for this shape
 	virtual v2f VertexShader(const Ray& ray, const RayResult& rayResult) const = 0;
@@ -52,6 +67,9 @@ public:
 	// Intersects a ray against this object in the object's local space
 	virtual bool IntersectLocal(const Ray& ray, glm::vec3& normal, int& data, float& depth) const = 0;
 
+	// Builds whatever needs loaded assets, false while they're still loading
+	virtual bool FinishLoad() { return true; }
+
 	// Sets the CPU shader type for this entity // @TODO: Could have shadertype per material instead, maybe one day
 	void SetShader(Shader shaderType);
 
@@ -0,0 +1,52 @@
+#include "EntityStore.h"
+
+#include "Game/Entity.h"
+
+void EntityStore::Arrays::Clear() {
+	worldAABB.clear();
+	invModelMatrix.clear();
+	for (auto& arr : invModel) arr.clear();
+	id.clear();
+	entity.clear();
+}
+
+void EntityStore::Arrays::Add(Entity* obj) {
+	worldAABB.push_back(obj->worldAABB);
+	invModelMatrix.push_back(obj->invModelMatrix);
+	for (int col = 0; col < 4; col++)
+		for (int row = 0; row < 3; row++)
+			invModel[col * 3 + row].push_back(obj->invModelMatrix[col][row]);
+	id.push_back(obj->id);
+	entity.push_back(obj);
+}
+
+void EntityStore::Arrays::Pad() {
+	// Padded lanes are never read as hits, kernels mask them out by Size()
+	size_t padded = (Size() + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+	for (auto& arr : invModel) arr.resize(padded, 0.0f);
+	id.resize(padded, 0);
+}
+
+void EntityStore::Build(const std::vector<std::unique_ptr<Entity>>& entities) {
+	spheres.Clear();
+	disks.Clear();
+	boxes.Clear();
+	meshes.Clear();
+	meshBvhs.clear();
+
+	for (const auto& obj : entities) {
+		switch (obj->type) {
+			case Entity::Type::Sphere: spheres.Add(obj.get()); break;
+			case Entity::Type::Disk: disks.Add(obj.get()); break;
+			case Entity::Type::Box: boxes.Add(obj.get()); break;
+			case Entity::Type::RenderedMesh:
+				meshes.Add(obj.get());
+				meshBvhs.push_back(&obj->GetBvh());
+				break;
+		}
+	}
+
+	spheres.Pad();
+	disks.Pad();
+	boxes.Pad();
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <glm/glm.hpp>
+
+#include "Engine/Common.h"
+
+class Entity;
+class Bvh;
+
+// Packed copy of the per entity data raycasts touch, one set of arrays per shape type
+// Lets RaycastScene loop each type with its own non-virtual intersection instead of chasing entity pointers
+// Entity is still the API for setting up scenes, this is rebuilt from it in Scene::UpdateTransforms
+class EntityStore {
+public:
+
+	// Width of the batched intersection kernels, per component arrays are padded to a multiple of this
+	static constexpr int SIMD_WIDTH = 8;
+
+	// Hot data of every entity of a single type, index i in each array refers to the same entity
+	struct Arrays {
+		std::vector<AABB> worldAABB;
+		std::vector<glm::mat4x3> invModelMatrix;
+		std::vector<float> invModel[12]; // Same matrices split per component for SIMD, invModel[column * 3 + row], padded
+		std::vector<int> id; // Padded
+		std::vector<Entity*> entity; // Cold data, only touched on hit
+
+		size_t Size() const { return entity.size(); }
+		void Clear();
+		void Add(Entity* obj);
+		void Pad();
+	};
+
+	Arrays spheres, disks, boxes, meshes;
+	std::vector<const Bvh*> meshBvhs; // Parallel to meshes
+
+	// Rebuilds every array from given entities, keeps capacity
+	void Build(const std::vector<std::unique_ptr<Entity>>& entities);
+};
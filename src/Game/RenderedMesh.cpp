@@ -4,6 +4,7 @@
 
 #include "Engine/Timer.h"
 #include "Engine/Log.h"
+#include "Engine/MeshSimplifier.h"
 #include "Rendering/RayResult.h"
 
 RenderedMesh::RenderedMesh(const std::string& name, const int& meshHandle) {
@@ -12,10 +13,17 @@ RenderedMesh::RenderedMesh(const std::string& name, const int& meshHandle) {
 	this->name = name;
 	id = idCount--;
 	SetShader(Shader::Textured);
-	GenerateBVH();
+	if (Assets::Meshes[meshHandle].ready.load(std::memory_order_acquire)) GenerateBVH(); // Async meshes build in FinishLoad()
 	materials.push_back(Material());
 }
 
+bool RenderedMesh::FinishLoad() {
+	if (!bvh.stack.empty()) return true;
+	if (!Assets::Meshes[meshHandle].ready.load(std::memory_order_acquire)) return false;
+	GenerateBVH();
+	return true;
+}
+
 void RenderedMesh::GenerateBVH() {
 
 	// Quick hack for serializing a bvh // @TODO: Refactor
@@ -59,29 +67,55 @@ void RenderedMesh::GenerateBVH() {
 	}
 }
 
+void RenderedMesh::GenerateLods(int count, float ratio) {
+
+	lods.clear();
+	activeLod = -1;
+	const Mesh* prev = Assets::Meshes[meshHandle].get();
+
+	for (int i = 0; i < count; i++) {
+		const size_t target = (size_t)((prev->triangles.size() / 3) * ratio);
+		if (target < 16) break; // Not worth it
+
+		auto simplified = MeshSimplifier::Simplify(*prev, target);
+		const float edgeLength = MeshSimplifier::AverageEdgeLength(*simplified);
+		int handle = Assets::AddMesh(std::move(simplified));
+		prev = Assets::Meshes[handle].get();
+
+		lods.push_back(MeshLod{ .meshHandle = handle, .edgeLength = edgeLength });
+		lods.back().bvh.Generate(prev->vertices, prev->triangles);
+
+		// Collapsed vertices can move slightly outside the original bounds
+		aabb.Encapsulate(lods.back().bvh.stack[0].aabb.min);
+		aabb.Encapsulate(lods.back().bvh.stack[0].aabb.max);
+	}
+
+	fmt::println("Generated {} lods for {}", lods.size(), name);
+}
+
 bool RenderedMesh::IntersectLocal(const Ray& ray, glm::vec3& normal, int& triIdx, float& depth) const {
-	return bvh.Intersect(ray, normal, triIdx, depth);
+	return GetBvh().Intersect(ray, normal, triIdx, depth);
 }
 
 v2f RenderedMesh::VertexShader(const Ray& ray, const RayResult& rayResult) const {
 	v2f ret;
 
-	const auto& mesh = Assets::Meshes[meshHandle];
+	const auto& mesh = GetMesh();
 	const auto& v0i = mesh->triangles[rayResult.triIndex + 0];
 	const auto& v1i = mesh->triangles[rayResult.triIndex + 1];
 	const auto& v2i = mesh->triangles[rayResult.triIndex + 2];
 	const auto& p0 = mesh->vertices[v0i];
 	const auto& p1 = mesh->vertices[v1i];
 	const auto& p2 = mesh->vertices[v2i];
-	//const auto& c0 = mesh->colors[v0i];
-	//const auto& c1 = mesh->colors[v1i];
-	//const auto& c2 = mesh->colors[v2i];
-	const auto& n0 = mesh->normals[v0i];
-	const auto& n1 = mesh->normals[v1i];
-	const auto& n2 = mesh->normals[v2i];
-	const auto& uv0 = mesh->uvs[v0i];
-	const auto& uv1 = mesh->uvs[v1i];
-	const auto& uv2 = mesh->uvs[v2i];
+	//const auto c0 = mesh->GetColor(v0i);
+	//const auto c1 = mesh->GetColor(v1i);
+	//const auto c2 = mesh->GetColor(v2i);
+	const auto n0 = mesh->GetNormal(v0i);
+	const auto n1 = mesh->GetNormal(v1i);
+	const auto n2 = mesh->GetNormal(v2i);
+	const auto uv0 = mesh->GetUV(v0i);
+	const auto uv1 = mesh->GetUV(v1i);
+	const auto uv2 = mesh->GetUV(v2i);
 	//const auto& material = mesh->materialIDs[rayResult.triIndex / 3];
 
 	// Barycentric interpolation
@@ -93,13 +127,23 @@ v2f RenderedMesh::VertexShader(const Ray& ray, const RayResult& rayResult) const
 	ret.uv = uv0 * b.x + uv1 * b.y + uv2 * b.z;
 
 	// Vertex normals interpolated if exist
-	if (HasMesh() && Assets::Meshes[meshHandle]->hasNormals)
+	if (HasMesh() && mesh->hasNormals)
 		ret.localNormal = normalize(n0 * b.x + n1 * b.y + n2 * b.z);
 	else
 		ret.localNormal = rayResult.faceNormal;
 
 	ret.worldNormal = transform.rotation * ret.localNormal;
 
+	// Ray cone footprint for texture lod, uv to world area ratio of the triangle turns the cone width into uv units
+	const float coneWidth = ray.ConeWidthAt(rayResult.depth);
+	if (coneWidth > 0.0f) {
+		const float uvArea = glm::abs((uv1.x - uv0.x) * (uv2.y - uv0.y) - (uv2.x - uv0.x) * (uv1.y - uv0.y));
+		const float worldArea = glm::length(glm::cross((p1 - p0) * transform.scale, (p2 - p0) * transform.scale));
+		const float cosTheta = glm::abs(glm::dot(transform.rotation * rayResult.faceNormal, ray.rd));
+		if (worldArea > 0.0f)
+			ret.uvFootprint = coneWidth * glm::sqrt(uvArea / worldArea) / glm::max(cosTheta, 0.01f);
+	}
+
 	return ret;
 }
 
@@ -117,9 +161,9 @@ Color RenderedMesh::SampleAt(const glm::vec3& pos, int triIndex) const {
 	const auto& p0 = mesh->vertices[v0i];
 	const auto& p1 = mesh->vertices[v1i];
 	const auto& p2 = mesh->vertices[v2i];
-	const auto& uv0 = mesh->uvs[v0i];
-	const auto& uv1 = mesh->uvs[v1i];
-	const auto& uv2 = mesh->uvs[v2i];
+	const auto uv0 = mesh->GetUV(v0i);
+	const auto uv1 = mesh->GetUV(v1i);
+	const auto uv2 = mesh->GetUV(v2i);
 
 	const glm::vec3 b = Utils::Barycentric(pos, p0, p1, p2);
 	const auto uv = uv0 * b.x + uv1 * b.y + uv2 * b.z;
@@ -138,9 +182,9 @@ Color RenderedMesh::SampleTriangle(int triIndex, const glm::vec3& barycentric) c
 	const auto& v0i = mesh->triangles[triIndex + 0];
 	const auto& v1i = mesh->triangles[triIndex + 1];
 	const auto& v2i = mesh->triangles[triIndex + 2];
-	const auto& uv0 = mesh->uvs[v0i];
-	const auto& uv1 = mesh->uvs[v1i];
-	const auto& uv2 = mesh->uvs[v2i];
+	const auto uv0 = mesh->GetUV(v0i);
+	const auto uv1 = mesh->GetUV(v1i);
+	const auto uv2 = mesh->GetUV(v2i);
 
 	const auto uv = uv0 * barycentric.x + uv1 * barycentric.y + uv2 * barycentric.z;
 	return Assets::Textures[texID]->SampleUVClamp(uv);
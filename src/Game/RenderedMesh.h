@@ -15,6 +15,12 @@ public:
 	// Generates the BVH for the mesh on this obj
 	void GenerateBVH();
 
+	// Generates the BVH once an async loaded mesh is in, see Scene::AddWhenLoaded
+	bool FinishLoad() override;
+
+	// Generates count simplified versions of the mesh, each with ratio of the previous one's triangles
+	void GenerateLods(int count, float ratio = 0.25f);
+
 	// Intersects a ray against the BVH of this mesh
 	bool IntersectLocal(const Ray& ray, glm::vec3& normal, int& triIdx, float& depth) const;
 
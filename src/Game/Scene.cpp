@@ -83,6 +83,7 @@ void Scene::ReadAndAddTestObjects() {
 		rendMesh->transform.scale = glm::vec3(10.0f);
 		rendMesh->transform.position += glm::vec3(4.0f, -0.5f, 0.0f);
 		rendMesh->shaderType = Shader::PlainWhite;
+		rendMesh->GenerateLods(3);
 		
 		Game::scene.entities.push_back(std::move(rendMesh));
 	}
@@ -104,7 +105,7 @@ void Scene::ReadAndAddTestObjects() {
 
 #if false // Mesh
 	{
-		auto meshHandle = Assets::NewMesh(std::filesystem::path("models/sponza/sponza.fbx"), Assets::ImportOpts{ .ignoreMaterials = { 14, 28, 32, 39 } });
+		auto meshHandle = Assets::NewMesh(std::filesystem::path("models/sponza/sponza.fbx"), Assets::ImportOpts{ .compactVertices = true, .ignoreMaterials = { 14, 28, 32, 39 } });
 		auto rendMesh = std::make_unique<RenderedMesh>("sponza", meshHandle);
 
 		// Sometimes normals in slot0, just hardcode basecolor instead
@@ -116,16 +117,16 @@ void Scene::ReadAndAddTestObjects() {
 			//Log::Line(a.materialName, a.textureFilename);
 		}
 
-		// Read textures multithreaded
+		// Textures load in the background, flat grey until they're done
 		rendMesh->materials.resize(Assets::Meshes[meshHandle]->materialMetadata.size());
-		concurrency::parallel_for(size_t(0), Assets::Meshes[meshHandle]->materialMetadata.size(), [&](size_t i) {
+		for (size_t i = 0; i < rendMesh->materials.size(); i++) {
 			const auto& file = Assets::Meshes[meshHandle]->materialMetadata[i].textureFilename;
 			auto path = std::filesystem::path("models/sponza/textures") / file;
 			if (file != "" && std::filesystem::exists(path))
-				rendMesh->materials[i] = Material{ .textureHandle = Assets::NewTexture(path, Assets::ImportOpts{.flipY = true }) };
+				rendMesh->materials[i] = Material{ .textureHandle = Assets::NewTextureAsync(path, Assets::ImportOpts{.flipY = true, .streamTexture = true }) };
 			else
 				rendMesh->materials[i] = Material();
-		});
+		}
 
 		rendMesh->shaderType = Shader::Textured;
 		Game::scene.entities.push_back(std::move(rendMesh));
@@ -134,7 +135,7 @@ void Scene::ReadAndAddTestObjects() {
 
 #if true // Mesh
 	{
-		auto meshHandle = Assets::NewMesh(std::filesystem::path("models/triangleBall2.fbx"));
+		auto meshHandle = Assets::NewMeshAsync(std::filesystem::path("models/triangleBall2.fbx"), Assets::ImportOpts{ .compactVertices = true });
 		auto rendMesh = std::make_unique<RenderedMesh>("ball", meshHandle);
 		
 		rendMesh->materials[0].reflectivity = 0.5f;
@@ -144,11 +145,62 @@ void Scene::ReadAndAddTestObjects() {
 		rendMesh->transform.LookAtDir(glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0));
 		rendMesh->SetShader(Shader::PlainWhite);
 
-		Game::scene.entities.push_back(std::move(rendMesh));
+		Game::scene.AddWhenLoaded(std::move(rendMesh));
 	}
 #endif
 }
 
+void Scene::AddWhenLoaded(std::unique_ptr<Entity> obj) {
+	loading.push_back(std::move(obj));
+}
+
+void Scene::UpdateTransforms() {
+
+	// Nothing is tracing while this runs so entities can change here
+	std::erase_if(loading, [&](std::unique_ptr<Entity>& obj) {
+		if (!obj->FinishLoad()) return false;
+		entities.push_back(std::move(obj));
+		return true;
+	});
+
+	// @TODO: Caching, transform hierarchies etc etc.. maybe one day
+	concurrency::parallel_for(size_t(0), entities.size(), [&](size_t i) {
+		auto& obj = entities[i];
+		obj->modelMatrix = obj->transform.ToMatrix();
+		obj->invModelMatrix = glm::inverse(obj->modelMatrix);
+		
+		// Calculate rotated AABB for every obj
+		glm::mat4x4 lowPts =  { obj->aabb.GetVertice(0), obj->aabb.GetVertice(1), obj->aabb.GetVertice(2), obj->aabb.GetVertice(3), };
+		lowPts = obj->modelMatrix * lowPts;
+		glm::mat4x4 highPts = { obj->aabb.GetVertice(4), obj->aabb.GetVertice(5), obj->aabb.GetVertice(6), obj->aabb.GetVertice(7), };
+		highPts = obj->modelMatrix * highPts;
+		AABB globalAABB = AABB(lowPts[0], lowPts[0]);
+		for (int i = 0; i < 4; i++) { globalAABB.Encapsulate(lowPts[i]); globalAABB.Encapsulate(highPts[i]); }
+		obj->worldAABB = globalAABB;
+
+		// Lod picked per object from camera distance, not per ray, so shadow and secondary rays see the same surface primary rays hit
+		obj->activeLod = -1;
+		if (!obj->lods.empty() && lodThreshold > 0.0f) {
+			const glm::vec3 camPos = camera.transform.position;
+			const float dist = glm::distance(camPos, glm::clamp(camPos, globalAABB.min, globalAABB.max));
+			const float scale = glm::max(obj->transform.scale.x, glm::max(obj->transform.scale.y, obj->transform.scale.z));
+			for (int k = 0; k < obj->lods.size(); k++) {
+				if (obj->lods[k].edgeLength * scale > lodThreshold * dist) break;
+				obj->activeLod = k;
+			}
+		}
+	});
+
+	// Scene bounds
+	bounds = entities.empty() ? AABB(glm::vec3(0.0f)) : entities[0]->worldAABB;
+	for (const auto& obj : entities) {
+		bounds.Encapsulate(obj->worldAABB.min);
+		bounds.Encapsulate(obj->worldAABB.max);
+	}
+
+	store.Build(entities);
+}
+
 Entity* Scene::GetObjectByName(const std::string& name) const {
 	for (const auto& obj : entities)
 		if (obj->name == name) return obj.get();
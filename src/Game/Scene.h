@@ -4,6 +4,7 @@
 #include <memory>
 
 #include "Game/Entity.h"
+#include "Game/EntityStore.h"
 #include "Game/Camera.h"
 #include "Rendering/Light.h"
 
@@ -16,12 +17,30 @@ public:
 	// The scene is a flat structure rather than a tree for now
 	std::vector<std::unique_ptr<Entity>> entities;
 
+	// Entities whose assets are still loading, moved to entities by UpdateTransforms once they're done
+	std::vector<std::unique_ptr<Entity>> loading;
+
+	// Packed per type copy of entities for raycasts, rebuilt in UpdateTransforms
+	EntityStore store;
+
 	// List of all lights in the scene
 	std::vector<Light> lights;
 
 	// Camera of the scene
 	Camera camera;
 
+	// World bounds of every entity, updated along with transforms
+	AABB bounds;
+
+	// Coarsest mesh lod is used whose average edge covers less than this angle (radians) from the camera, 0 = always full detail
+	float lodThreshold = 0.02f;
+
+	// Updates model matrices and world AABBs of every entity and rebuilds the entity store
+	void UpdateTransforms();
+
+	// Adds an entity that uses async loaded assets (Assets::NewMeshAsync), it joins entities on the first UpdateTransforms after they're in
+	void AddWhenLoaded(std::unique_ptr<Entity> obj);
+
 	// Highly variable function that reads and/or generates a bunch of whatever test models are currently used
 	void ReadAndAddTestObjects();
 
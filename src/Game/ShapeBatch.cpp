@@ -0,0 +1,178 @@
+#include "ShapeBatch.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "Game/Shapes.h"
+
+#if defined(__AVX2__)
+
+// Ray broadcast to every lane
+struct RayLanes {
+	__m256 ro[3], rd[3];
+	__m256i mask;
+	RayLanes(const Ray& ray) {
+		for (int i = 0; i < 3; i++) {
+			ro[i] = _mm256_set1_ps(ray.ro[i]);
+			rd[i] = _mm256_set1_ps(ray.rd[i]);
+		}
+		mask = _mm256_set1_epi32(ray.mask);
+	}
+};
+
+// Transforms the ray to the local space of shapes [i, i + 8)
+inline void TransformRay(const EntityStore::Arrays& arr, size_t i, const RayLanes& ray, __m256 ro[3], __m256 rd[3]) {
+	for (int row = 0; row < 3; row++) {
+		__m256 c0 = _mm256_loadu_ps(arr.invModel[0 * 3 + row].data() + i);
+		__m256 c1 = _mm256_loadu_ps(arr.invModel[1 * 3 + row].data() + i);
+		__m256 c2 = _mm256_loadu_ps(arr.invModel[2 * 3 + row].data() + i);
+		__m256 c3 = _mm256_loadu_ps(arr.invModel[3 * 3 + row].data() + i);
+		ro[row] = _mm256_fmadd_ps(c0, ray.ro[0], _mm256_fmadd_ps(c1, ray.ro[1], _mm256_fmadd_ps(c2, ray.ro[2], c3)));
+		rd[row] = _mm256_fmadd_ps(c0, ray.rd[0], _mm256_mul_ps(c1, ray.rd[1]));
+		rd[row] = _mm256_fmadd_ps(c2, ray.rd[2], rd[row]);
+	}
+}
+
+inline __m256 Dot(const __m256 a[3], const __m256 b[3]) {
+	return _mm256_fmadd_ps(a[0], b[0], _mm256_fmadd_ps(a[1], b[1], _mm256_mul_ps(a[2], b[2])));
+}
+
+// Picks the closest valid lane, hit is a lane mask from the shape test
+inline void PickClosest(const EntityStore::Arrays& arr, size_t i, const RayLanes& ray, __m256 depth, __m256 hit, int& best, float& bestDepth) {
+
+	// Drop padding lanes, masked ids and anything behind the current best
+	const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	const __m256i valid = _mm256_cmpgt_epi32(_mm256_set1_epi32((int)(arr.Size() - i)), lane);
+	const __m256i masked = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*)(arr.id.data() + i)), ray.mask);
+	hit = _mm256_and_ps(hit, _mm256_castsi256_ps(_mm256_andnot_si256(masked, valid)));
+	hit = _mm256_and_ps(hit, _mm256_cmp_ps(depth, _mm256_set1_ps(bestDepth), _CMP_LT_OQ));
+
+	int bits = _mm256_movemask_ps(hit);
+	if (bits == 0) return;
+
+	alignas(32) float depths[8];
+	_mm256_store_ps(depths, depth);
+	for (int j = 0; j < 8; j++) {
+		if ((bits & (1 << j)) && depths[j] < bestDepth) {
+			bestDepth = depths[j];
+			best = (int)i + j;
+		}
+	}
+}
+
+int ShapeBatch::ClosestSphere(const EntityStore::Arrays& arr, const Ray& ray, float maxDepth) {
+	int best = -1;
+	const RayLanes r(ray);
+	const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+
+	for (size_t i = 0; i < arr.Size(); i += EntityStore::SIMD_WIDTH) {
+		__m256 ro[3], rd[3];
+		TransformRay(arr, i, r, ro, rd);
+
+		// Same as Sphere::Intersect
+		__m256 a = Dot(rd, rd);
+		__m256 b = Dot(ro, rd);
+		__m256 c = _mm256_sub_ps(Dot(ro, ro), one);
+		__m256 h = _mm256_fnmadd_ps(a, c, _mm256_mul_ps(b, b));
+
+		__m256 hit = _mm256_and_ps(_mm256_cmp_ps(b, zero, _CMP_LE_OQ), _mm256_cmp_ps(c, zero, _CMP_GE_OQ));
+		hit = _mm256_and_ps(hit, _mm256_cmp_ps(h, zero, _CMP_GE_OQ));
+
+		__m256 depth = _mm256_div_ps(_mm256_sub_ps(_mm256_sub_ps(zero, b), _mm256_sqrt_ps(_mm256_max_ps(h, zero))), a);
+
+		PickClosest(arr, i, r, depth, hit, best, maxDepth);
+	}
+	return best;
+}
+
+int ShapeBatch::ClosestBox(const EntityStore::Arrays& arr, const Ray& ray, float maxDepth) {
+	int best = -1;
+	const RayLanes r(ray);
+	const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f), minusOne = _mm256_set1_ps(-1.0f);
+
+	for (size_t i = 0; i < arr.Size(); i += EntityStore::SIMD_WIDTH) {
+		__m256 ro[3], rd[3];
+		TransformRay(arr, i, r, ro, rd);
+
+		// Same slab test as Box::Intersect, the world AABB prefilter is skipped as it's about as expensive
+		__m256 minT = _mm256_set1_ps(-std::numeric_limits<float>::max());
+		__m256 maxT = _mm256_set1_ps(std::numeric_limits<float>::max());
+		for (int k = 0; k < 3; k++) {
+			__m256 inv = _mm256_div_ps(one, rd[k]);
+			__m256 a = _mm256_mul_ps(_mm256_sub_ps(minusOne, ro[k]), inv);
+			__m256 b = _mm256_mul_ps(_mm256_sub_ps(one, ro[k]), inv);
+			minT = _mm256_max_ps(minT, _mm256_min_ps(a, b));
+			maxT = _mm256_min_ps(maxT, _mm256_max_ps(a, b));
+		}
+
+		__m256 hit = _mm256_and_ps(_mm256_cmp_ps(minT, maxT, _CMP_LE_OQ), _mm256_cmp_ps(minT, zero, _CMP_GT_OQ));
+
+		PickClosest(arr, i, r, minT, hit, best, maxDepth);
+	}
+	return best;
+}
+
+int ShapeBatch::ClosestDisk(const EntityStore::Arrays& arr, const Ray& ray, float maxDepth) {
+	int best = -1;
+	const RayLanes r(ray);
+	const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f), eps = _mm256_set1_ps(0.00001f);
+	const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+
+	for (size_t i = 0; i < arr.Size(); i += EntityStore::SIMD_WIDTH) {
+		__m256 ro[3], rd[3];
+		TransformRay(arr, i, r, ro, rd);
+
+		// Same as Disk::Intersect, plane normal is local up
+		__m256 depth = _mm256_div_ps(_mm256_sub_ps(zero, ro[1]), rd[1]);
+		__m256 qx = _mm256_fmadd_ps(rd[0], depth, ro[0]);
+		__m256 qz = _mm256_fmadd_ps(rd[2], depth, ro[2]);
+		__m256 qy = _mm256_fmadd_ps(rd[1], depth, ro[1]);
+		__m256 sqrDist = _mm256_fmadd_ps(qx, qx, _mm256_fmadd_ps(qy, qy, _mm256_mul_ps(qz, qz)));
+
+		__m256 hit = _mm256_cmp_ps(_mm256_and_ps(rd[1], absMask), eps, _CMP_GE_OQ);
+		hit = _mm256_and_ps(hit, _mm256_cmp_ps(depth, zero, _CMP_GE_OQ));
+		hit = _mm256_and_ps(hit, _mm256_cmp_ps(sqrDist, one, _CMP_LT_OQ));
+
+		PickClosest(arr, i, r, depth, hit, best, maxDepth);
+	}
+	return best;
+}
+
+#else
+
+// Scalar fallback, one shape at a time with the same kernels as the per entity path
+template <typename Kernel>
+inline int Closest(const EntityStore::Arrays& arr, const Ray& ray, float maxDepth, const Kernel& kernel) {
+	int best = -1;
+	glm::vec3 nrm;
+	float depth;
+
+	for (size_t i = 0; i < arr.Size(); i++) {
+		if (arr.id[i] == ray.mask) continue;
+		if (arr.worldAABB[i].Intersect(ray) == 0.0f) continue;
+
+		glm::mat2x3 newPosDir = arr.invModelMatrix[i] * glm::mat2x4(glm::vec4(ray.ro, 1.0f), glm::vec4(ray.rd, 0.0f));
+		Ray localRay{ .ro = newPosDir[0], .rd = newPosDir[1], .inv_rd = 1.0f / newPosDir[1], .mask = ray.mask };
+
+		if (kernel(localRay, nrm, depth) && depth < maxDepth) {
+			maxDepth = depth;
+			best = (int)i;
+		}
+	}
+	return best;
+}
+
+int ShapeBatch::ClosestSphere(const EntityStore::Arrays& arr, const Ray& ray, float maxDepth) {
+	return Closest(arr, ray, maxDepth, Sphere::Intersect);
+}
+
+int ShapeBatch::ClosestBox(const EntityStore::Arrays& arr, const Ray& ray, float maxDepth) {
+	return Closest(arr, ray, maxDepth, Box::Intersect);
+}
+
+int ShapeBatch::ClosestDisk(const EntityStore::Arrays& arr, const Ray& ray, float maxDepth) {
+	return Closest(arr, ray, maxDepth, Disk::Intersect);
+}
+
+#endif
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "Engine/Common.h"
+#include "Game/EntityStore.h"
+
+// Intersects one ray against every shape of a type, 8 shapes at a time with AVX2 or one by one without
+// Only finds the closest shape, the caller re-intersects that one for normals etc.
+class ShapeBatch {
+	ShapeBatch() {}
+public:
+
+	// Each returns the index of the closest hit in arr that's closer than maxDepth, -1 if none
+	// Shapes with id == ray.mask are skipped
+	static int ClosestSphere(const EntityStore::Arrays& arr, const Ray& ray, float maxDepth);
+	static int ClosestBox(const EntityStore::Arrays& arr, const Ray& ray, float maxDepth);
+	static int ClosestDisk(const EntityStore::Arrays& arr, const Ray& ray, float maxDepth);
+};
@@ -31,17 +31,22 @@ Sphere::Sphere(const glm::vec3& pos, const float& radius) {
 
 bool Sphere::IntersectLocal(const Ray& ray, glm::vec3& normal, int& data, float& depth) const {
 	if (ray.mask == id) return false;
+	data = id;
+	return Intersect(ray, normal, depth);
+}
+
+bool Sphere::Intersect(const Ray& ray, glm::vec3& normal, float& depth) {
 	// Adapted from Inigo Quilez https://iquilezles.org/articles/
-	const glm::vec3 nrm_rd = glm::normalize(ray.rd);
-	float b = glm::dot(ray.ro, nrm_rd);
+	// Solved with the unnormalized local rd so depth comes out directly in world units, no normalize + rescale needed
+	float a = glm::dot(ray.rd, ray.rd);
+	float b = glm::dot(ray.ro, ray.rd);
 	if (b > 0.0f) return false; // Looking 180 degs away
 	float c = glm::dot(ray.ro, ray.ro) - 1.0f;
 	if (c < 0.0f) return false; // Ray inside sphere
-	float h = b * b - c;
+	float h = b * b - a * c;
 	if (h < 0.0f) return false;
-	depth = (-b - sqrt(h)) * transform.scale.x;
+	depth = (-b - sqrt(h)) / a;
 	normal = glm::normalize(ray.ro + ray.rd * depth);
-	data = id;
 	return true;
 }
 
@@ -68,11 +73,15 @@ Disk::Disk(const glm::vec3& pos, const glm::vec3& normal, const float& radius) {
 
 bool Disk::IntersectLocal(const Ray& ray, glm::vec3& normal, int& data, float& depth) const {
 	if (ray.mask == id) return false;
+	data = id;
+	return Intersect(ray, normal, depth);
+}
+
+bool Disk::Intersect(const Ray& ray, glm::vec3& normal, float& depth) {
 	normal = glm::vec3(0, 1, 0);
 	float div = glm::dot(normal, ray.rd);
 	if (glm::abs(div) < 0.00001f) return false;
 	depth = -glm::dot(ray.ro, normal) / div;
-	data = id;
 	if (depth < 0.0f) return false;
 	glm::vec3 q = ray.ro + ray.rd * depth;
 	if (glm::dot(q,q) < 1.0f) return true;
@@ -97,17 +106,25 @@ Box::Box(const glm::vec3& pos, const glm::vec3& size) {
 
 bool Box::IntersectLocal(const Ray& ray, glm::vec3& normal, int& data, float& depth) const {
 	if (ray.mask == id) return false;
-	const float res = AABB(1.0f).Intersect(ray);
-	if (res > 0.0f && id != ray.mask) {
-		depth = res;
-		normal = LocalNormal(ray.ro + ray.rd * res);
-		data = id;
-		return true;
-	}
-	return false;
+	data = id;
+	return Intersect(ray, normal, depth);
+}
+
+bool Box::Intersect(const Ray& ray, glm::vec3& normal, float& depth) {
+	// Slab test against the unit box, no need to construct an AABB for it
+	glm::vec3 a = (-1.0f - ray.ro) * ray.inv_rd;
+	glm::vec3 b = ( 1.0f - ray.ro) * ray.inv_rd;
+	glm::vec3 mi = glm::min(a, b);
+	glm::vec3 ma = glm::max(a, b);
+	float minT = glm::max(glm::max(mi.x, mi.y), mi.z);
+	float maxT = glm::min(glm::min(ma.x, ma.y), ma.z);
+	if (minT > maxT || minT <= 0.0f) return false; // Miss, behind or inside
+	depth = minT;
+	normal = LocalNormal(ray.ro + ray.rd * minT);
+	return true;
 }
 
-glm::vec3 Box::LocalNormal(const glm::vec3& pos) const {
+glm::vec3 Box::LocalNormal(const glm::vec3& pos) {
 	using namespace glm;
 	const glm::vec3 nrm = pos;// / (transform.scale);
 	if (abs(nrm.x) > abs(nrm.y) && abs(nrm.x) > abs(nrm.z))
@@ -10,6 +10,7 @@ struct Sphere : Entity {
 public:
 	Sphere(const glm::vec3& pos, const float& radius);
 	bool IntersectLocal(const Ray& ray, glm::vec3& normal, int& data, float& depth) const;
+	static bool Intersect(const Ray& ray, glm::vec3& normal, float& depth); // Non-virtual kernel, no masking
 	glm::vec3 LocalNormal(const glm::vec3& pos) const;
 	v2f VertexShader(const Ray& ray, const RayResult& rayResult) const;
 };
@@ -19,6 +20,7 @@ struct Disk : Entity {
 public:
 	Disk(const glm::vec3& pos, const glm::vec3& normal, const float& radius);
 	bool IntersectLocal(const Ray& ray, glm::vec3& normal, int& data, float& depth) const;
+	static bool Intersect(const Ray& ray, glm::vec3& normal, float& depth); // Non-virtual kernel, no masking
 	v2f VertexShader(const Ray& ray, const RayResult& rayResult) const;
 };
 
@@ -27,7 +29,8 @@ struct Box : Entity {
 public:
 	Box(const glm::vec3& pos, const glm::vec3& size);
 	bool IntersectLocal(const Ray& ray, glm::vec3& normal, int& data, float& depth) const;
-	glm::vec3 LocalNormal(const glm::vec3& pos) const;
+	static bool Intersect(const Ray& ray, glm::vec3& normal, float& depth); // Non-virtual kernel, no masking
+	static glm::vec3 LocalNormal(const glm::vec3& pos);
 	v2f VertexShader(const Ray& ray, const RayResult& rayResult) const;
 };
 
@@ -0,0 +1,96 @@
+#include "IrradianceCache.h"
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+using namespace glm;
+
+uint64_t IrradianceCache::Key(const ivec3& cell, int axis) {
+	// 20 bits per coordinate offset to positive + 3 bits of normal axis
+	constexpr int bias = 1 << 19;
+	constexpr uint64_t mask = (1 << 20) - 1;
+	return ((uint64_t)(cell.x + bias) & mask) | (((uint64_t)(cell.y + bias) & mask) << 20) | (((uint64_t)(cell.z + bias) & mask) << 40) | ((uint64_t)axis << 60);
+}
+
+int IrradianceCache::DominantAxis(const vec3& nrm) {
+	vec3 a = abs(nrm);
+	if (a.x > a.y && a.x > a.z) return nrm.x < 0.0f ? 1 : 0;
+	if (a.y > a.z) return nrm.y < 0.0f ? 3 : 2;
+	return nrm.z < 0.0f ? 5 : 4;
+}
+
+void IrradianceCache::Add(const vec3& pos, const vec3& nrm, const vec4& clr) {
+
+	const ivec3 cell = ivec3(floor(pos / cellSize));
+	auto [it, inserted] = cells.try_emplace(Key(cell, DominantAxis(nrm)), Cell{ .clr = clr, .nrm = nrm, .samples = 1, .lastUpdate = update });
+	if (inserted) return;
+
+	// Running average, capped so changes in lighting eventually show up
+	Cell& c = it->second;
+	if (c.samples < MAX_SAMPLES) c.samples++;
+	const float t = 1.0f / (float)c.samples;
+	c.clr += (clr - c.clr) * t;
+	c.nrm += (nrm - c.nrm) * t;
+	c.lastUpdate = update;
+}
+
+bool IrradianceCache::Sample(const vec3& pos, const vec3& nrm, vec4& clr) const {
+
+	if (cells.empty()) return false;
+
+	// Cell values live at cell centers, blend the 8 around pos
+	const vec3 p = pos / cellSize - 0.5f;
+	const ivec3 base = ivec3(floor(p));
+	const vec3 f = p - vec3(base);
+	const int axis = DominantAxis(nrm);
+
+	vec4 sum = vec4(0.0f);
+	float weightSum = 0.0f;
+
+	for (int i = 0; i < 8; i++) {
+		const ivec3 offset = ivec3(i & 1, (i >> 1) & 1, (i >> 2) & 1);
+		const auto it = cells.find(Key(base + offset, axis));
+		if (it == cells.end()) continue;
+
+		const vec3 w3 = mix(1.0f - f, f, vec3(offset));
+		const float w = w3.x * w3.y * w3.z;
+
+		// Same receiver normal penalty as SampleGI
+		const float anglePenalty = max(0.0f, dot(nrm, normalize(it->second.nrm)));
+		sum += it->second.clr * anglePenalty * w;
+		weightSum += w;
+	}
+
+	if (weightSum <= 0.0f) return false;
+	clr = sum / weightSum;
+	return true;
+}
+
+void IrradianceCache::Evict() {
+
+	update++;
+
+	std::erase_if(cells, [&](const auto& kv) { return update - kv.second.lastUpdate > maxAge; });
+
+	// Still over budget, drop the least recently updated cells
+	const size_t maxCells = memoryBudget / CELL_BYTES;
+	if (cells.size() <= maxCells) return;
+
+	std::vector<uint32_t> ages;
+	ages.reserve(cells.size());
+	for (const auto& [key, cell] : cells) ages.push_back(update - cell.lastUpdate);
+
+	// Cutoff age that leaves maxCells cells
+	size_t toRemove = cells.size() - maxCells;
+	std::nth_element(ages.begin(), ages.begin() + (toRemove - 1), ages.end(), std::greater<uint32_t>());
+	const uint32_t cutoff = ages[toRemove - 1];
+
+	toRemove -= std::erase_if(cells, [&](const auto& kv) { return update - kv.second.lastUpdate > cutoff; });
+
+	// Ties at the cutoff age, drop just enough of them
+	for (auto it = cells.begin(); it != cells.end() && toRemove > 0;) {
+		if (update - it->second.lastUpdate == cutoff) { it = cells.erase(it); toRemove--; }
+		else ++it;
+	}
+}
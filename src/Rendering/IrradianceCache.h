@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <glm/glm.hpp>
+
+// Sparse world space grid of indirect light received by surfaces, persists across frames
+// Filled from the indirect pass results and used where the per frame indirect points don't reach (offscreen areas, skipped updates)
+// Cells are keyed by grid position + dominant normal axis so opposite sides of thin surfaces don't mix
+class IrradianceCache {
+public:
+
+	// Size of a single cell in world units
+	float cellSize = 0.25f;
+
+	// Cells not written to in this many updates get evicted
+	uint32_t maxAge = 600;
+
+	// Max memory used by cells, oldest get evicted first when over
+	size_t memoryBudget = 8 * 1024 * 1024;
+
+	// Blends a sample into the cell containing pos
+	void Add(const glm::vec3& pos, const glm::vec3& nrm, const glm::vec4& clr);
+
+	// Trilinearly samples cells around pos, returns false if there was nothing nearby
+	bool Sample(const glm::vec3& pos, const glm::vec3& nrm, glm::vec4& clr) const;
+
+	// Advances the age counter and drops old cells + oldest ones that go over the memory budget
+	void Evict();
+
+	void Clear() { cells.clear(); }
+
+	size_t Count() const { return cells.size(); }
+
+	// Approximate memory used by cells incl. map overhead
+	size_t MemoryUsage() const { return cells.size() * CELL_BYTES; }
+
+private:
+
+	struct Cell {
+		glm::vec4 clr;
+		glm::vec3 nrm; // Averaged receiver normal
+		uint32_t samples;
+		uint32_t lastUpdate;
+	};
+
+	// Rough size of an unordered_map node + bucket for a cell
+	static constexpr size_t CELL_BYTES = sizeof(Cell) + sizeof(uint64_t) + 4 * sizeof(void*);
+
+	// Samples are blended as a running average up to this count, after which older values fade out
+	static constexpr uint32_t MAX_SAMPLES = 16;
+
+	static uint64_t Key(const glm::ivec3& cell, int axis);
+
+	static int DominantAxis(const glm::vec3& nrm);
+
+	std::unordered_map<uint64_t, Cell> cells;
+	uint32_t update = 0;
+};
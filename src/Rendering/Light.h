@@ -4,6 +4,7 @@
 
 #include "Engine/Common.h"
 #include "Engine/BvhPoint.h"
+#include "Rendering/IrradianceCache.h"
 
 struct Light {
 	glm::vec3 position;
@@ -12,12 +13,11 @@ struct Light {
 
 	// Struct for querying positions this light hits, useful for soft shadows, gameplay etc..
 	BvhPoint<Empty> lightBvh;
-	std::vector<glm::vec4> _lightBvhTempBuffer; // Temp points to be added to shadowbvh every frame
 
-	std::vector<LightbufferPt> _indirectTempBuffer; // Temp points to be added to indirect buffer every frame
-	std::vector<LightbufferPt> _toAddBuffer; // Reduced size buffer without invalid values to be passed to bvh constructor
+	std::vector<LightbufferPt> _indirectTempBuffer; // Points traced for the indirect buffer, kept between frames since updates are interleaved
 
 	BvhPoint<LightbufferPayload> indirectBvh; // Contains points representing indirect light this light emits
+	IrradianceCache irradianceCache; // Indirect light from previous updates, used where indirectBvh has nothing
 
 	// Calculates boring lighting for given pos/nrm
 	// @TODO: Exciting lighting instead
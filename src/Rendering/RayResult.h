@@ -37,6 +37,9 @@ public:
 	float cumulativeDepth = 0.0f;
 	int recursionDepth = 0;
 
+	// Per light shadow terms computed ahead of shading, if set shaders skip their own shadow rays (wavefront mode)
+	const float* shadows = nullptr;
+
 private:
 	Arg val = Default;
 };
\ No newline at end of file
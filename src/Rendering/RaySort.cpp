@@ -0,0 +1,17 @@
+#include "RaySort.h"
+
+#include <ppl.h> // Parallel sort
+
+#include "Engine/Utils.h"
+
+uint32_t RaySort::Key(const glm::vec3& dir, const glm::vec3& pos, const AABB& bounds) {
+	uint32_t octant = (dir.x < 0.0f ? 1u : 0u) | (dir.y < 0.0f ? 2u : 0u) | (dir.z < 0.0f ? 4u : 0u);
+	glm::vec3 normalized = (pos - bounds.min) / glm::max(bounds.max - bounds.min, glm::vec3(0.0001f));
+
+	// 3 octant bits + 27 bits of morton code, lowest level of the morton grid is finer than needed anyway
+	return (octant << 27) | (Utils::Morton3D(normalized) >> 3);
+}
+
+void RaySort::Sort(std::vector<uint64_t>& packed) {
+	concurrency::parallel_sort(packed.begin(), packed.end());
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Engine/Common.h"
+
+// Reorders ray traversal so rays going the same way through the same area get traced together, better BVH cache hit rates
+// Rays themselves aren't moved, a sorted list of packed (key, index) pairs gives the order to trace them in
+class RaySort {
+	RaySort() {}
+public:
+
+	// Returns a sort key for a ray, direction octant in the top bits followed by the morton code of pos inside bounds
+	static uint32_t Key(const glm::vec3& dir, const glm::vec3& pos, const AABB& bounds);
+
+	// Packs a key with the index of the ray it belongs to
+	static uint64_t Pack(uint32_t key, int index) { return ((uint64_t)key << 32) | (uint32_t)index; }
+
+	// Returns the ray index of a packed key
+	static int Index(uint64_t packed) { return (int)(packed & 0xFFFFFFFF); }
+
+	// Sorts packed keys in parallel
+	static void Sort(std::vector<uint64_t>& packed);
+};
@@ -4,8 +4,14 @@
 
 #include "Game/Shapes.h"
 #include "Game/RenderedMesh.h"
+#include "Game/ShapeBatch.h"
 #include "Rendering/Shaders.h"
+#include "Rendering/RaySort.h"
 #include "Engine/Log.h"
+#include "Engine/Time.h"
+#include "Engine/TexturePages.h"
+#include "Engine/FrameArena.h"
+#include "Engine/MemoryStats.h"
 
 using namespace glm; // Math heavy file, convenience
 
@@ -13,6 +19,8 @@ using namespace glm; // Math heavy file, convenience
 void Raytracer::Create(const Window& window) {
 
 	this->window = &window;
+	width = window.width;
+	height = window.height;
 
 	vtxLayout
 		.begin()
@@ -27,7 +35,8 @@ void Raytracer::Create(const Window& window) {
 	bgfx::TextureInfo info;
 	bgfx::calcTextureSize(info, window.width, window.height, 1, false, false, 1, textureFormat);
 	textureBufferSize = info.storageSize;
-	textureBuffer = new Color[textureBufferSize];
+	for (Color*& buffer : outputBuffers) buffer = new Color[textureBufferSize / sizeof(Color)];
+	textureBuffer = outputBuffers[0];
 
 	u_texture = bgfx::createUniform("s_tex", bgfx::UniformType::Sampler);
 
@@ -45,6 +54,15 @@ void Raytracer::Create(const Window& window) {
 	bgfx::setViewRect(VIEW_LAYER, 0, 0, bgfx::BackbufferRatio::Equal);
 }
 
+void Raytracer::CreateHeadless(int width, int height) {
+	this->width = width;
+	this->height = height;
+	headless = true;
+	textureBufferSize = width * height * sizeof(Color);
+	for (Color*& buffer : outputBuffers) buffer = new Color[width * height];
+	textureBuffer = outputBuffers[0];
+}
+
 vec4 Raytracer::SampleColor(const Scene& scene, const RayResult& rayResult, const Ray& ray, TraceData& data) const {
 
 	// Interpolate variables in "vertex shader"
@@ -56,15 +74,12 @@ vec4 Raytracer::SampleColor(const Scene& scene, const RayResult& rayResult, cons
 	// Reflection
 	if (data.HasFlag(TraceData::Reflection)) {
 
-		float reflectivity;
-		if (rayResult.obj->type == Entity::Type::RenderedMesh)
-			reflectivity = rayResult.obj->materials[rayResult.obj->GetMesh()->materialIDs[rayResult.triIndex / 3]].reflectivity;
-		else
-			reflectivity = rayResult.obj->materials[0].reflectivity; // Assert parametric objs have 1 material
+		float reflectivity = rayResult.obj->GetMaterial(rayResult.triIndex).reflectivity;
 
 		if (reflectivity != 0.0f && data.recursionDepth < 2) {
 			vec3 newRd = reflect(ray.rd, rayResult.obj->transform.rotation * rayResult.faceNormal);
-			Ray newRay{ .ro = interpolated.worldPosition, .rd = newRd, .inv_rd = 1.0f / newRd, .mask = rayResult.id };
+			Ray newRay{ .ro = interpolated.worldPosition, .rd = newRd, .inv_rd = 1.0f / newRd, .mask = rayResult.id,
+				.coneWidth = ray.ConeWidthAt(rayResult.depth), .coneSpread = ray.coneSpread };
 			data.recursionDepth++;
 			vec4 reflColor = TracePath(scene, newRay, data);
 			c = Utils::Lerp(c, reflColor, reflectivity);
@@ -74,6 +89,31 @@ vec4 Raytracer::SampleColor(const Scene& scene, const RayResult& rayResult, cons
 	return c;
 }
 
+// Intersects a ray against entity i of a type and keeps it if it's the closest hit, kernel does the type specific local space test
+template <typename Kernel>
+inline void IntersectEntity(const EntityStore::Arrays& arr, size_t i, const Ray& ray, RayResult& result, const Kernel& kernel) {
+
+	// Inverse transform ray to the object's space
+	mat2x3 newPosDir = arr.invModelMatrix[i] * mat2x4(
+		vec4(ray.ro, 1.0f),
+		vec4(ray.rd, 0.0f)
+	);
+	Ray localRay { .ro = newPosDir[0], .rd = newPosDir[1], .inv_rd = 1.0f / newPosDir[1], .mask = ray.mask };
+
+	int data = arr.id[i];
+	float depth;
+	vec3 nrm;
+
+	// Check if hit something and if it's the closest hit
+	if (kernel(localRay, nrm, data, depth) && depth < result.depth) {
+		result.depth = depth;
+		result.id = data;
+		result.localPos = localRay.ro + localRay.rd * depth;
+		result.faceNormal = nrm;
+		result.obj = arr.entity[i];
+	}
+}
+
 RayResult Raytracer::RaycastScene(const Scene& scene, const Ray& ray) const {
 
 	RayResult result{
@@ -84,35 +124,34 @@ RayResult Raytracer::RaycastScene(const Scene& scene, const Ray& ray) const {
 		.id = std::numeric_limits<int>::min()
 	};
 
-	bool intersect;
-	float depth;
-	int data;
-	vec3 nrm;
+	// Loop all objects type by type, could use something more sophisticated but simple loops get us pretty far
+	const EntityStore& store = scene.store;
+
+	// Parametric shapes are tested in batches, only the closest one gets re-intersected for the full result
+	int closest = ShapeBatch::ClosestSphere(store.spheres, ray, result.depth);
+	if (closest >= 0) IntersectEntity(store.spheres, closest, ray, result, [](const Ray& localRay, vec3& nrm, int& data, float& depth) {
+		return Sphere::Intersect(localRay, nrm, depth);
+	});
 
-	// Loop all objects, could use something more sophisticated but a simple loop gets us pretty far
-	for (const auto& entity : scene.entities) {
+	closest = ShapeBatch::ClosestBox(store.boxes, ray, result.depth);
+	if (closest >= 0) IntersectEntity(store.boxes, closest, ray, result, [](const Ray& localRay, vec3& nrm, int& data, float& depth) {
+		return Box::Intersect(localRay, nrm, depth);
+	});
+
+	closest = ShapeBatch::ClosestDisk(store.disks, ray, result.depth);
+	if (closest >= 0) IntersectEntity(store.disks, closest, ray, result, [](const Ray& localRay, vec3& nrm, int& data, float& depth) {
+		return Disk::Intersect(localRay, nrm, depth);
+	});
+
+	// Meshes are masked per triangle inside the BVH
+	for (size_t i = 0; i < store.meshes.Size(); i++) {
 
 		// Early bounding box rejection for missed rays
-		if (entity->worldAABB.Intersect(ray) == 0.0f) continue;
-
-		// Inverse transform ray to the object's space
-		mat2x3 newPosDir = entity->invModelMatrix * mat2x4(
-			vec4(ray.ro, 1.0f),
-			vec4(ray.rd, 0.0f)
-		);
-		Ray localRay { .ro = newPosDir[0], .rd = newPosDir[1], .inv_rd = 1.0f / newPosDir[1], .mask = ray.mask };
-
-		// Check intersect (virtual function call but perf cost irrelevant compared to the entire frame)
-		intersect = entity->IntersectLocal(localRay, nrm, data, depth);
-
-		// Check if hit something and if it's the closest hit
-		if (intersect && depth < result.depth) {
-			result.depth = depth;
-			result.id = data;
-			result.localPos = localRay.ro + localRay.rd * depth;
-			result.faceNormal = nrm;
-			result.obj = entity.get();
-		}
+		if (store.meshes.worldAABB[i].Intersect(ray) == 0.0f) continue;
+
+		IntersectEntity(store.meshes, i, ray, result, [&](const Ray& localRay, vec3& nrm, int& data, float& depth) {
+			return store.meshBvhs[i]->Intersect(localRay, nrm, data, depth) != 0.0f;
+		});
 	}
 
 	return result;
@@ -135,7 +174,8 @@ vec4 Raytracer::TracePath(const Scene& scene, const Ray& ray, TraceData& data) c
 		// If we hit a transparent or cutout surface, skip it and check further
 		if (data.HasFlag(TraceData::Transparent) && c.a < 0.99f && data.recursionDepth < 2) {
 			vec3 hitPt = ray.ro + ray.rd * rayResult.depth;
-			Ray newRay{ .ro = hitPt, .rd = ray.rd, .inv_rd = ray.inv_rd, .mask = rayResult.id };
+			Ray newRay{ .ro = hitPt, .rd = ray.rd, .inv_rd = ray.inv_rd, .mask = rayResult.id,
+				.coneWidth = ray.ConeWidthAt(rayResult.depth), .coneSpread = ray.coneSpread };
 			data.recursionDepth++;
 			vec4 behind = TracePath(scene, newRay, data);
 			c = Utils::Lerp(c, behind, 1.0f - c.a);
@@ -152,336 +192,558 @@ vec4 Raytracer::TracePath(const Scene& scene, const Ray& ray, TraceData& data) c
 	}
 }
 
-void Raytracer::SmoothShadowsPass(Scene& scene, const mat4x4& projInv, const mat4x4& viewInv) {
-
-	// Prepass for generating light buffer for interpolating smooth shadows
-	lightBufferSampleTimer.Start();
+std::vector<TaskGraph::Node> Raytracer::SmoothShadowsPass(Scene& scene, const mat4x4& projInv, const mat4x4& viewInv) {
 
 	// Clear and regenerate light buffer for each light
-	for (auto& light : scene.lights) {
+	for (auto& light : scene.lights)
 		light.lightBvh.Clear();
-		light._lightBvhTempBuffer.clear();
-	}
 
 	// Tiling and downsampling parameters for this pass
 	constexpr int sizeDiv = 4;
 	constexpr int tileSize = 4;
-	const int scaledWidth = window->width / sizeDiv;
-	const int scaledHeight = window->height / sizeDiv;
+	const int scaledWidth = traceWidth / sizeDiv;
+	const int scaledHeight = traceHeight / sizeDiv;
 	const int numScaledXtiles = scaledWidth / tileSize;
 	const int numScaledYtiles = scaledHeight / tileSize;
-	screenTempBuffer.resize(scaledWidth * scaledHeight);
+	std::span<vec4> screenPts = FrameArena::Alloc<vec4>(scaledWidth * scaledHeight);
 
-	// Shoot rays from camera to find areas that are in light, these are used for smooth shadows later
-	concurrency::parallel_for(0, numScaledXtiles * numScaledYtiles, [&](int tile) {
+	// Prepass for generating light buffer for interpolating smooth shadows
+	const TaskGraph::Node sample = frameGraph.Add([=, this, &scene]() {
+		lightBufferSampleTimer.Start();
 
-		int tileX = tile % numScaledXtiles;
-		int tileY = tile / numScaledXtiles;
+		// Shoot rays from camera to find areas that are in light, these are used for smooth shadows later
+		concurrency::parallel_for(0, numScaledXtiles * numScaledYtiles, [&](int tile) {
 
-		for (int j = 0; j < tileSize; j++) {
-			for (int i = 0; i < tileSize; i++) {
-				float xcoord = ((float)tileX * tileSize + i) / (float)scaledWidth;
-				float ycoord = ((float)tileY * tileSize + j) / (float)scaledHeight;
-				int textureIndex = tileX * tileSize + i + ((tileY * tileSize + j) * scaledWidth);
+			int tileX = tile % numScaledXtiles;
+			int tileY = tile / numScaledXtiles;
 
-				// Create view ray from proj/view matrices
-				vec2 pixel = vec2(xcoord, ycoord) * 2.0f - 1.0f;
-				vec4 px = vec4(pixel, 0.0f, 1.0f);
-				px = projInv * px;
-				px.w = 0.0f;
-				vec3 dir = viewInv * px;
-				dir = normalize(dir);
+			for (int j = 0; j < tileSize; j++) {
+				for (int i = 0; i < tileSize; i++) {
+					float xcoord = ((float)tileX * tileSize + i) / (float)scaledWidth;
+					float ycoord = ((float)tileY * tileSize + j) / (float)scaledHeight;
+					int textureIndex = tileX * tileSize + i + ((tileY * tileSize + j) * scaledWidth);
 
-				// Raycast
-				Ray ray{ .ro = scene.camera.transform.position, .rd = dir, .inv_rd = 1.0f / dir, .mask = std::numeric_limits<int>::min() };
-				RayResult res = RaycastScene(scene, ray);
+					// Create view ray from proj/view matrices
+					vec2 pixel = vec2(xcoord, ycoord) * 2.0f - 1.0f;
+					vec4 px = vec4(pixel, 0.0f, 1.0f);
+					px = projInv * px;
+					px.w = 0.0f;
+					vec3 dir = viewInv * px;
+					dir = normalize(dir);
 
-				if (res.Hit()) {
+					// Raycast
+					Ray ray{ .ro = scene.camera.transform.position, .rd = dir, .inv_rd = 1.0f / dir, .mask = std::numeric_limits<int>::min() };
+					RayResult res = RaycastScene(scene, ray);
 
-					const vec3 hitpt = ray.ro + ray.rd * res.depth;
+					if (res.Hit()) {
 
-					// Loop all lights and save a bitmask representing which light indices are fully lit
-					int mask = 0;
+						const vec3 hitpt = ray.ro + ray.rd * res.depth;
 
-					for (int j = 0; j < scene.lights.size(); j++) {
-						vec3 os = scene.lights[j].position - hitpt;
-						float lightDist = length(os);
-						os /= lightDist;
-						Ray ray2{ .ro = hitpt, .rd = os, .inv_rd = 1.0f / os, .mask = res.id };
-						RayResult res2 = RaycastScene(scene, ray2);
+						// Loop all lights and save a bitmask representing which light indices are fully lit
+						int mask = 0;
 
-						if (!res2.Hit() || res2.depth > lightDist - 0.001f)
-							mask |= 1 << j;
-					}
+						for (int j = 0; j < scene.lights.size(); j++) {
+							vec3 os = scene.lights[j].position - hitpt;
+							float lightDist = length(os);
+							os /= lightDist;
+							Ray ray2{ .ro = hitpt, .rd = os, .inv_rd = 1.0f / os, .mask = res.id };
+							RayResult res2 = RaycastScene(scene, ray2);
 
-					// @TODO: Pack blocker dist as uint16 (ratio / max_uint16)
-					// Doing shadow rays every pixel doesn't scale
+							if (!res2.Hit() || res2.depth > lightDist - 0.001f)
+								mask |= 1 << j;
+						}
 
-					// Save all lights that are lighting this point in space
-					screenTempBuffer[textureIndex] = vec4(hitpt, std::bit_cast<float>(mask));
-				}
-				else {
-					// If we didn't hit anything just clear the index
-					screenTempBuffer[textureIndex] = vec4(std::bit_cast<float>(0));
+						// @TODO: Pack blocker dist as uint16 (ratio / max_uint16)
+						// Doing shadow rays every pixel doesn't scale
+
+						// Save all lights that are lighting this point in space
+						screenPts[textureIndex] = vec4(hitpt, std::bit_cast<float>(mask));
+					}
+					else {
+						// If we didn't hit anything just clear the index
+						screenPts[textureIndex] = vec4(std::bit_cast<float>(0));
+					}
 				}
 			}
-		}
+		});
+
+		lightBufferSampleTimer.End();
+		lightBufferGenTimer.Start();
 	});
 
-	// Add each point to each lights internal shadow buffer if the point was lit by that light
-	for (const auto& val : screenTempBuffer) {
-		for (int i = 0; i < scene.lights.size(); i++) {
-			if ((std::bit_cast<int>(val.w) & (1 << i)) == 0) continue;
-			scene.lights[i]._lightBvhTempBuffer.push_back(val);
-		}
+	// Generate the view light buffer for each light from the points that were lit by it
+	// One job per light so the builds overlap with the indirect pass instead of all waiting for the slowest light
+	std::vector<TaskGraph::Node> lightJobs;
+	for (size_t i = 0; i < scene.lights.size(); i++) {
+		lightJobs.push_back(frameGraph.Add([=, &scene]() {
+			const auto lit = FrameArena::Compact<vec4>(screenPts, [i](const vec4& val) { return (std::bit_cast<int>(val.w) & (1 << i)) != 0; });
+			scene.lights[i].lightBvh.Generate(lit.data(), (int)lit.size());
+		}, { sample }));
 	}
+	if (lightJobs.empty()) lightJobs.push_back(sample);
 
-	lightBufferSampleTimer.End();
-	lightBufferGenTimer.Start();
-
-	// Generate the view light buffer for each light
-	concurrency::parallel_for(size_t(0), scene.lights.size(), [&](size_t i) {
-		const auto& arr = scene.lights[i]._lightBvhTempBuffer;
-		scene.lights[i].lightBvh.Generate(arr.data(), (int)arr.size());
-	});
-
-	lightBufferGenTimer.End();
+	return { frameGraph.Add([this]() { lightBufferGenTimer.End(); }, lightJobs) };
 }
 
-void Raytracer::IndirectLightingPass(Scene& scene, const mat4x4& projInv, const mat4x4& viewInv) {
+std::vector<TaskGraph::Node> Raytracer::IndirectLightingPass(Scene& scene, const mat4x4& projInv, const mat4x4& viewInv, std::span<const TaskGraph::Node> shadowJobs) {
 
 	// Shoot rays from camera to find indirect light for pts hit
 	// This data could theoretically be much lower res than entire screen if blurred
 
-	indirectSampleTimer.Start();
-
-	for (auto& light : scene.lights) {
-		light._indirectTempBuffer.resize(screenTempBuffer.size());
-	}
-
 	// Tiling and downsampling parameters for this pass
-	constexpr int sizeDiv = 4;
+	const int sizeDiv = max(indirectSizeDiv, 1);
 	constexpr int tileSize = 4;
-	const int scaledWidth = window->width / sizeDiv;
-	const int scaledHeight = window->height / sizeDiv;
+	const int scaledWidth = traceWidth / sizeDiv;
+	const int scaledHeight = traceHeight / sizeDiv;
 	const int numScaledXtiles = scaledWidth / tileSize;
 	const int numScaledYtiles = scaledHeight / tileSize;
 
-	// For every screenspace point, calculate the expected reflection here and save to buffer
-	concurrency::parallel_for(0, numScaledXtiles * numScaledYtiles, [&](int tile) {
+	// Buffers are only valid for the resolution they were made at, anything changing forces a full update
+	bool fullUpdate = scaledWidth != indirectWidth || scaledHeight != indirectHeight;
+	for (auto& light : scene.lights) {
+		if (light._indirectTempBuffer.size() == (size_t)scaledWidth * scaledHeight) continue;
+		light._indirectTempBuffer.assign(scaledWidth * scaledHeight, LightbufferPt{ .pt = vec3(), .indirect {.clr = Colors::Clear, .nrm = vec3() } });
+		fullUpdate = true;
+	}
+	indirectWidth = scaledWidth;
+	indirectHeight = scaledHeight;
+
+	// Skipped frames keep using each light's indirect bvh from the last update
+	const int interval = max(indirectInterval, 1);
+	const int frame = indirectFrame++;
+	if (!fullUpdate && frame % interval != 0) return {};
+
+	// Round robin, updates refresh 1 interleaved set of tiles and the rest keep their old points
+	const int tileSets = fullUpdate ? 1 : max(indirectTileSets, 1);
+	const int tileSet = (frame / interval) % tileSets;
+
+	const int numTiles = numScaledXtiles * numScaledYtiles;
+	indirectTileRays.resize(numTiles);
+	indirectTileCandidates.resize(numTiles);
+
+	constexpr float maxReflDist = 4.0f;
+
+	// Refresh per light reflection data for meshes, static lights + meshes keep theirs across frames
+	const TaskGraph::Node caches = frameGraph.Add([=, this, &scene]() {
+		indirectSampleTimer.Start();
+
+		reflectionCacheJobs.clear();
+		for (const auto& obj : scene.entities) {
+			if (obj->type != Entity::Type::RenderedMesh || !obj->GetBvh().Exists()) continue;
+			obj->reflectionCaches.resize(scene.lights.size());
+			for (int lightIndex = 0; lightIndex < scene.lights.size(); lightIndex++) {
+				vec3 tfLightpos = obj->invModelMatrix * vec4(scene.lights[lightIndex].position, 1.0f);
+				if (!obj->reflectionCaches[lightIndex].IsValid(obj->GetBvh(), tfLightpos))
+					reflectionCacheJobs.push_back({ obj.get(), lightIndex });
+			}
+		}
+		concurrency::parallel_for(0, (int)reflectionCacheJobs.size(), [&](int i) {
+			auto [obj, lightIndex] = reflectionCacheJobs[i];
+			vec3 tfLightpos = obj->invModelMatrix * vec4(scene.lights[lightIndex].position, 1.0f);
+			obj->GetBvh().BuildReflectionCache(tfLightpos, obj->reflectionCaches[lightIndex]);
+		});
+	});
+
+	// For every screenspace point, figure out the reflection points and queue a ray from the light to each of them
+	const TaskGraph::Node gather = frameGraph.Add([=, this, &scene]() {
+		concurrency::parallel_for(0, numTiles, [&](int tile) {
 
-		int tileX = tile % numScaledXtiles;
-		int tileY = tile / numScaledXtiles;
+			int tileX = tile % numScaledXtiles;
+			int tileY = tile / numScaledXtiles;
 
-		for (int j = 0; j < tileSize; j++) {
-			for (int i = 0; i < tileSize; i++) {
-				float xcoord = ((float)tileX * tileSize + i) / (float)scaledWidth;
-				float ycoord = ((float)tileY * tileSize + j) / (float)scaledHeight;
-				int textureIndex = tileX * tileSize + i + ((tileY * tileSize + j) * scaledWidth);
+			auto& tileRays = indirectTileRays[tile];
+			tileRays.clear();
 
-				// Create view ray from proj/view matrices
-				vec2 pixel = vec2(xcoord, ycoord) * 2.0f - 1.0f;
-				vec4 px = vec4(pixel, 0.0f, 1.0f);
-				px = projInv * px;
-				px.w = 0.0f;
-				vec3 dir = viewInv * px;
-				dir = normalize(dir);
+			if ((tileX + tileY) % tileSets != tileSet) return;
 
-				// Raycast
-				const Ray ray{ .ro = scene.camera.transform.position, .rd = dir, .inv_rd = 1.0f / dir, .mask = std::numeric_limits<int>::min() };
-				const RayResult res = RaycastScene(scene, ray);
+			// Trace the whole tile first so we know its bounds before looking for reflectors
+			Ray rays[tileSize * tileSize];
+			RayResult results[tileSize * tileSize];
+			AABB tileBounds;
+			bool anyHit = false;
 
-				if (!res.Hit()) {
-					
-					// If we didn't hit anything just clear the index
-					for (auto& light : scene.lights)
-						light._indirectTempBuffer[textureIndex] = LightbufferPt{ .pt = vec3(), .indirect {.clr = Colors::Clear, .nrm = vec3() } };
-					
-					continue;
-				}
+			for (int j = 0; j < tileSize; j++) {
+				for (int i = 0; i < tileSize; i++) {
+					float xcoord = ((float)tileX * tileSize + i) / (float)scaledWidth;
+					float ycoord = ((float)tileY * tileSize + j) / (float)scaledHeight;
 
-				// Hit something, figure out indirect for this pt
-				const vec3 hitpt = ray.ro + ray.rd * res.depth;
+					// Create view ray from proj/view matrices
+					vec2 pixel = vec2(xcoord, ycoord) * 2.0f - 1.0f;
+					vec4 px = vec4(pixel, 0.0f, 1.0f);
+					px = projInv * px;
+					px.w = 0.0f;
+					vec3 dir = viewInv * px;
+					dir = normalize(dir);
 
-				// Loop potential lights @TODO: Scene top level acceleration structure
-				for (auto& light : scene.lights) {
+					// Raycast
+					const Ray ray{ .ro = scene.camera.transform.position, .rd = dir, .inv_rd = 1.0f / dir, .mask = std::numeric_limits<int>::min() };
+					const RayResult res = RaycastScene(scene, ray);
+					rays[j * tileSize + i] = ray;
+					results[j * tileSize + i] = res;
 
-					// Skip pts outside light range
-					if (Utils::SqrLength(light.position - hitpt) > light.range * light.range) continue;
+					if (!res.Hit()) continue;
 
-					vec4 indirect = vec4(0.0f);
-					bool hasReflections = false;
+					const vec3 hitpt = ray.ro + ray.rd * res.depth;
+					if (!anyHit) tileBounds = AABB(hitpt);
+					else tileBounds.Encapsulate(hitpt);
+					anyHit = true;
+				}
+			}
+
+			// Only objects within max reflection distance of the tile can reflect onto any of its points
+			// Disks don't cast reflections below so they're skipped here already
+			auto& candidates = indirectTileCandidates[tile];
+			candidates.clear();
+			if (anyHit) {
+				const AABB searchBounds = AABB(tileBounds.min - maxReflDist, tileBounds.max + maxReflDist);
+				for (const auto& obj : scene.entities)
+					if (obj->type != Entity::Type::Disk && obj->worldAABB.Overlaps(searchBounds))
+						candidates.push_back(obj.get());
+			}
+
+			for (int j = 0; j < tileSize; j++) {
+				for (int i = 0; i < tileSize; i++) {
+					int textureIndex = tileX * tileSize + i + ((tileY * tileSize + j) * scaledWidth);
+					const Ray& ray = rays[j * tileSize + i];
+					const RayResult& res = results[j * tileSize + i];
 
-					// Loop potential objs
-					for (const auto& obj : scene.entities) {
+					if (!res.Hit()) {
+					
+						// If we didn't hit anything just clear the index
+						for (auto& light : scene.lights)
+							light._indirectTempBuffer[textureIndex] = LightbufferPt{ .pt = vec3(), .indirect {.clr = Colors::Clear, .nrm = vec3() } };
+					
+						continue;
+					}
+
+					// Hit something, figure out indirect for this pt
+					const vec3 hitpt = ray.ro + ray.rd * res.depth;
 
-						if (obj.get() == res.obj) continue; // Disallow self reflections @TODO: Figure out why these look weird for some models
+					// Loop potential lights @TODO: Scene top level acceleration structure
+					for (int lightIndex = 0; lightIndex < scene.lights.size(); lightIndex++) {
+						auto& light = scene.lights[lightIndex];
 
-						constexpr float maxReflDist = 4.0f;
-						
-						// Skip testing object if it's further than its max reflection dist
-						float maxScale = max(obj->transform.scale.x, max(obj->transform.scale.y, obj->transform.scale.z));
-						if (Utils::SqrLength(obj->worldAABB.ClosestPoint(hitpt) - hitpt) > maxReflDist * maxReflDist)
+						// Skip pts outside light range
+						if (Utils::SqrLength(light.position - hitpt) > light.range * light.range) {
+							light._indirectTempBuffer[textureIndex] = LightbufferPt{ .pt = vec3(), .indirect {.clr = Colors::Clear, .nrm = vec3() } };
 							continue;
+						}
 
-						// Given raytrace hitpt + light position + object
-						// Compute the theoretical reflection point the obj would cast to this point, if any
-						vec3 reflectPt, worldNormal;
+						// Written as cleared, queued rays accumulate their color here after tracing
+						light._indirectTempBuffer[textureIndex] = LightbufferPt{ .pt = hitpt, .indirect {.clr = Colors::Clear, .nrm = res.obj->transform.rotation * res.faceNormal } };
 
-						// The calculations differ for each shape
+						// Loop potential objs near this tile
+						for (const Entity* obj : candidates) {
 
-						// Sphere
-						if (obj->type == Entity::Type::Sphere) {
+							if (obj == res.obj) continue; // Disallow self reflections @TODO: Figure out why these look weird for some models
 
-							// For spheres figuring out reflect pt + normal is trivial
-							vec3 p = obj->transform.position;
-							vec3 toHitpt = normalize(hitpt - p);
-							vec3 toLight = normalize(light.position - p);
-							reflectPt = obj->transform.position + normalize(toHitpt + toLight) * obj->transform.scale.x;
-							worldNormal = normalize(reflectPt - obj->transform.position);
-						}
+							// Skip testing object if it's further than its max reflection dist
+							float maxScale = max(obj->transform.scale.x, max(obj->transform.scale.y, obj->transform.scale.z));
+							if (Utils::SqrLength(obj->worldAABB.ClosestPoint(hitpt) - hitpt) > maxReflDist * maxReflDist)
+								continue;
 
-						// Box
-						else if (obj->type == Entity::Type::Box) {
-
-							// Figure out which side hitpt is closest to in local space
-							vec3 planePos;
-							vec3 tfHitpt = obj->invModelMatrix * vec4(hitpt, 1.0f);
-							if (abs(tfHitpt.x) > abs(tfHitpt.y) && abs(tfHitpt.x) > abs(tfHitpt.z))
-								worldNormal = vec3(1.0f, 0.0f, 0.0f) * sign(tfHitpt.x);
-							else if (abs(tfHitpt.y) > abs(tfHitpt.z))
-								worldNormal = vec3(0.0f, 1.0f, 0.0f) * sign(tfHitpt.y);
-							else
-								worldNormal = vec3(0.0f, 0.0f, 1.0f) * sign(tfHitpt.z);
-
-							// Transform local normal to world space along with scale and compute mid point on that plane
-							worldNormal = obj->transform.rotation * (worldNormal * obj->transform.scale); // World normal scaled
-							planePos = obj->transform.position + worldNormal;
-							worldNormal = normalize(worldNormal); // Renormalize
-
-							// Reflect a point behind this plane -> Intersection test with this fake point is the reflection pos
-							vec3 reflPt = planePos - reflect((planePos - hitpt), worldNormal);
-
-							// Do the intersection test in local space
-							vec3 ro = light.position;
-							vec3 rd = normalize(reflPt - light.position);
-							mat2x3 newPosDir = obj->invModelMatrix * mat2x4(vec4(ro, 1.0f), vec4(rd, 0.0f));
-							Ray rr{ .ro = newPosDir[0], .rd = newPosDir[1], .inv_rd = 1.0f / newPosDir[1], .mask = res.id };
-							int data; float depth; vec3 dummy;
-							float isect = obj->IntersectLocal(rr, dummy, data, depth);
-
-							if (isect <= 0.0f) continue; // No hit
-
-							reflectPt = ro + rd * depth;
-						}
+							// Given raytrace hitpt + light position + object
+							// Compute the theoretical reflection point the obj would cast to this point, if any
+							vec3 reflectPt, worldNormal;
 
-						// Mesh
-						else if (obj->type == Entity::Type::RenderedMesh) {
+							// The calculations differ for each shape
 
-							vec3 tfLightpos = obj->invModelMatrix * vec4(light.position, 1.0f);
+							// Sphere
+							if (obj->type == Entity::Type::Sphere) {
 
-							// Use reduced search range for meshes for perf
-							const float distLim = (maxReflDist * 0.5f) / maxScale;
-							Bvh::BvhTriangle tri;
-							vec3 tfHitpt = obj->invModelMatrix * vec4(hitpt, 1.0f);
+								// For spheres figuring out reflect pt + normal is trivial
+								vec3 p = obj->transform.position;
+								vec3 toHitpt = normalize(hitpt - p);
+								vec3 toLight = normalize(light.position - p);
+								reflectPt = obj->transform.position + normalize(toHitpt + toLight) * obj->transform.scale.x;
+								worldNormal = normalize(reflectPt - obj->transform.position);
+							}
 
-							// Sample mesh BVH for closest potentially reflecting tri
-							if (!obj->bvh.GetClosestReflectiveTri(tfHitpt, tfLightpos, distLim * distLim, res.triIndex, tri, reflectPt))
-								continue; // No triangles on this mesh reflect light to this pos
+							// Box
+							else if (obj->type == Entity::Type::Box) {
 
-							reflectPt = obj->modelMatrix * vec4(reflectPt, 1.0f);
-							worldNormal = normalize(obj->transform.rotation * tri.normal);
-						}
+								// Figure out which side hitpt is closest to in local space
+								vec3 planePos;
+								vec3 tfHitpt = obj->invModelMatrix * vec4(hitpt, 1.0f);
+								if (abs(tfHitpt.x) > abs(tfHitpt.y) && abs(tfHitpt.x) > abs(tfHitpt.z))
+									worldNormal = vec3(1.0f, 0.0f, 0.0f) * sign(tfHitpt.x);
+								else if (abs(tfHitpt.y) > abs(tfHitpt.z))
+									worldNormal = vec3(0.0f, 1.0f, 0.0f) * sign(tfHitpt.y);
+								else
+									worldNormal = vec3(0.0f, 0.0f, 1.0f) * sign(tfHitpt.z);
 
-						else continue; // Disk.. SDF... @TODO
+								// Transform local normal to world space along with scale and compute mid point on that plane
+								worldNormal = obj->transform.rotation * (worldNormal * obj->transform.scale); // World normal scaled
+								planePos = obj->transform.position + worldNormal;
+								worldNormal = normalize(worldNormal); // Renormalize
 
-						float hitptDist = length(hitpt - reflectPt);
-						if (hitptDist < 0.001f) continue; // Same pos
+								// Reflect a point behind this plane -> Intersection test with this fake point is the reflection pos
+								vec3 reflPt = planePos - reflect((planePos - hitpt), worldNormal);
 
-						vec3 toHitpt = (hitpt - reflectPt) / hitptDist;
-						vec3 toLight = normalize(light.position - reflectPt);
+								// Do the intersection test in local space
+								vec3 ro = light.position;
+								vec3 rd = normalize(reflPt - light.position);
+								mat2x3 newPosDir = obj->invModelMatrix * mat2x4(vec4(ro, 1.0f), vec4(rd, 0.0f));
+								Ray rr{ .ro = newPosDir[0], .rd = newPosDir[1], .inv_rd = 1.0f / newPosDir[1], .mask = res.id };
+								int data; float depth; vec3 dummy;
+								float isect = obj->IntersectLocal(rr, dummy, data, depth);
 
-						// Trace a ray from light to the reflection point
-						Ray lightRay{ .ro = light.position, .rd = -toLight, .inv_rd = -1.0f / toLight, .mask = std::numeric_limits<int>::min() };
+								if (isect <= 0.0f) continue; // No hit
 
-						TraceData data = TraceData::Reflection | TraceData::Shadows;
+								reflectPt = ro + rd * depth;
+							}
 
-						// Can't call TraceRay directly because we need to assume hit target == obj in case they're in shadow
-						RayResult rayResult = RaycastScene(scene, lightRay);
-						if (!rayResult.Hit() || rayResult.obj != obj.get()) continue;
-						vec4 color = SampleColor(scene, rayResult, lightRay, data);
+							// Mesh
+							else if (obj->type == Entity::Type::RenderedMesh) {
 
-						//color = vec4(0.0f, 1.0f, 1.0f, 1.0f); // Debug
+								// Use reduced search range for meshes for perf
+								const float distLim = (maxReflDist * 0.5f) / maxScale;
+								Bvh::BvhTriangle tri;
+								vec3 tfHitpt = obj->invModelMatrix * vec4(hitpt, 1.0f);
 
-						// Used to fade the edges of distance pruning
-						float reflectFade = 1.0f - Utils::InvLerpClamp(length(reflectPt - hitpt), 0.0f, maxReflDist);
-						reflectFade *= reflectFade * reflectFade; // 1/n^3 falloff seems good?
+								// Sample mesh BVH for closest potentially reflecting tri using the light's precomputed reflections
+								// Same lod the scene is traced and shaded with, self reflections are skipped above so there's no hit tri to mask
+								if (!obj->GetBvh().GetClosestReflectiveTri(obj->reflectionCaches[lightIndex], tfHitpt, distLim * distLim, -1, tri, reflectPt))
+									continue; // No triangles on this mesh reflect light to this pos
 
-						// Angle filter for reflection
-						float ang = (1.0f - dot(toHitpt, worldNormal)) * dot(toLight, worldNormal);
+								reflectPt = obj->modelMatrix * vec4(reflectPt, 1.0f);
+								worldNormal = normalize(obj->transform.rotation * tri.normal);
+							}
 
-						// Attenuation
-						float atten = light.CalcAttenuation(length(reflectPt - hitpt) + length(reflectPt - light.position));
+							else continue; // Disk.. SDF... @TODO
 
-						float intensity = ang * atten * reflectFade * 3.0f;
+							float hitptDist = length(hitpt - reflectPt);
+							if (hitptDist < 0.001f) continue; // Same pos
 
-						if (intensity < 1.0f / 255.0f + 0.001f) continue; // Don't add data if intensity is below 1/255
+							vec3 toHitpt = (hitpt - reflectPt) / hitptDist;
+							vec3 toLight = normalize(light.position - reflectPt);
 
-						indirect += color * intensity;
+							// Used to fade the edges of distance pruning
+							float reflectFade = 1.0f - Utils::InvLerpClamp(length(reflectPt - hitpt), 0.0f, maxReflDist);
+							reflectFade *= reflectFade * reflectFade; // 1/n^3 falloff seems good?
 
-						hasReflections = true;
-					}
+							// Angle filter for reflection
+							float ang = (1.0f - dot(toHitpt, worldNormal)) * dot(toLight, worldNormal);
+
+							// Attenuation
+							float atten = light.CalcAttenuation(length(reflectPt - hitpt) + length(reflectPt - light.position));
 
-					// Save the accumulated value
-					Color clr = Color::FromVec(indirect);
-					light._indirectTempBuffer[textureIndex] = LightbufferPt{ .pt = hitpt, .indirect {.clr = clr, .nrm = res.obj->transform.rotation * res.faceNormal } };
+							float intensity = ang * atten * reflectFade * 3.0f;
+
+							if (intensity < 1.0f / 255.0f + 0.001f) continue; // Don't add data if intensity is below 1/255
+
+							// Queue a ray from light to the reflection point
+							tileRays.push_back(IndirectRay{
+								.ray = Ray{ .ro = light.position, .rd = -toLight, .inv_rd = -1.0f / toLight, .mask = std::numeric_limits<int>::min() },
+								.reflectPt = reflectPt,
+								.obj = obj,
+								.intensity = intensity,
+								.textureIndex = textureIndex,
+								.light = lightIndex
+							});
+						}
+					}
 				}
 			}
+		});
+	}, { caches });
+
+	// Compact the per tile rays into a single queue
+	const TaskGraph::Node queue = frameGraph.Add([=, this, &scene]() {
+		indirectTileOffsets.resize(numTiles + 1);
+		indirectTileOffsets[0] = 0;
+		for (int tile = 0; tile < numTiles; tile++)
+			indirectTileOffsets[tile + 1] = indirectTileOffsets[tile] + (int)indirectTileRays[tile].size();
+
+		const int numRays = indirectTileOffsets[numTiles];
+		indirectRays.resize(numRays);
+		indirectRayColors.resize(numRays);
+
+		concurrency::parallel_for(0, numTiles, [&](int tile) {
+			std::copy(indirectTileRays[tile].begin(), indirectTileRays[tile].end(), indirectRays.begin() + indirectTileOffsets[tile]);
+		});
+
+		// Rays from the same light only differ by direction, so sort them by where they're going instead
+		if (sortRays) {
+			raySortTimer.Start();
+			indirectTraceOrder.resize(numRays);
+			concurrency::parallel_for(0, numRays, [&](int i) {
+				indirectTraceOrder[i] = RaySort::Pack(RaySort::Key(indirectRays[i].ray.rd, indirectRays[i].reflectPt, scene.bounds), i);
+			});
+			RaySort::Sort(indirectTraceOrder);
+			raySortTimer.Add();
 		}
-	});
+	}, { gather });
 
-	indirectSampleTimer.End();
-	indirectGenTimer.Start();
+	// Trace every queued ray, light rays sample smooth shadows so these wait for the shadow pass too
+	std::vector<TaskGraph::Node> traceDeps(shadowJobs.begin(), shadowJobs.end());
+	traceDeps.push_back(queue);
+	const TaskGraph::Node trace = frameGraph.Add([=, this, &scene]() {
+		concurrency::parallel_for(0, (int)indirectRays.size(), [&](int k) {
 
-	// Populate toAdd buffer for each light and generate bvh
-	concurrency::parallel_for(size_t(0), scene.lights.size(), [&](size_t i) {
+			const int i = sortRays ? RaySort::Index(indirectTraceOrder[k]) : k;
+			const IndirectRay& lightRay = indirectRays[i];
 
-		// Go over pts that had any data and add to temp buffer
-		auto& light = scene.lights[i];
-		light._toAddBuffer.clear();
-		for (const auto& val : light._indirectTempBuffer) {
-			if (val.indirect.clr.a == 0) continue;
-			light._toAddBuffer.push_back(val);
-		}
+			TraceData data = TraceData::Reflection | TraceData::Shadows;
 
-		// Regen BVH
-		light.indirectBvh.Generate(light._toAddBuffer.data(), (int)light._toAddBuffer.size());
-	});
+			// Can't call TraceRay directly because we need to assume hit target == obj in case they're in shadow
+			RayResult rayResult = RaycastScene(scene, lightRay.ray);
+			if (!rayResult.Hit() || rayResult.obj != lightRay.obj) {
+				indirectRayColors[i] = vec4(0.0f);
+				return;
+			}
+			vec4 color = SampleColor(scene, rayResult, lightRay.ray, data);
+
+			//color = vec4(0.0f, 1.0f, 1.0f, 1.0f); // Debug
+
+			indirectRayColors[i] = color * lightRay.intensity;
+		});
+	}, traceDeps);
+
+	// Accumulate ray colors back to their points, rays of the same point + light are next to each other inside a tile
+	const TaskGraph::Node accumulate = frameGraph.Add([=, this, &scene]() {
+		concurrency::parallel_for(0, numTiles, [&](int tile) {
+
+			vec4 indirect = vec4(0.0f);
+
+			for (int i = indirectTileOffsets[tile]; i < indirectTileOffsets[tile + 1]; i++) {
+				const IndirectRay& ray = indirectRays[i];
+				indirect += indirectRayColors[i];
+
+				// Save the accumulated value
+				bool last = i + 1 == indirectTileOffsets[tile + 1] || indirectRays[i + 1].textureIndex != ray.textureIndex || indirectRays[i + 1].light != ray.light;
+				if (last) {
+					scene.lights[ray.light]._indirectTempBuffer[ray.textureIndex].indirect.clr = Color::FromVec(indirect);
+					indirect = vec4(0.0f);
+				}
+			}
+		});
+
+		indirectSampleTimer.End();
+		indirectGenTimer.Start();
+	}, { trace });
 
-	indirectGenTimer.End();
+	// Populate toAdd buffer for each light and generate bvh, one job per light
+	std::vector<TaskGraph::Node> lightJobs;
+	for (size_t i = 0; i < scene.lights.size(); i++) {
+		lightJobs.push_back(frameGraph.Add([=, this, &scene]() {
+
+			// Go over pts that had any data and regen BVH from them
+			auto& light = scene.lights[i];
+			const auto toAdd = FrameArena::Compact<LightbufferPt>(light._indirectTempBuffer, [](const LightbufferPt& val) { return val.indirect.clr.a != 0; });
+			light.indirectBvh.Generate(toAdd.data(), (int)toAdd.size());
+
+			if (!useIrradianceCache) {
+				light.irradianceCache.Clear();
+				return;
+			}
+
+			// Blend pts traced this update into the world cache, pts in range without any indirect count too so stale light fades out
+			for (int tile = 0; tile < numTiles; tile++) {
+				const int tileX = tile % numScaledXtiles;
+				const int tileY = tile / numScaledXtiles;
+				if ((tileX + tileY) % tileSets != tileSet) continue;
+
+				for (int j = 0; j < tileSize; j++) {
+					for (int k = 0; k < tileSize; k++) {
+						const auto& val = light._indirectTempBuffer[tileX * tileSize + k + ((tileY * tileSize + j) * scaledWidth)];
+						if (val.indirect.nrm == vec3(0.0f)) continue; // No hit or out of range
+						light.irradianceCache.Add(val.pt, val.indirect.nrm, val.indirect.clr.ToVec4());
+					}
+				}
+			}
+			light.irradianceCache.Evict();
+		}, { accumulate }));
+	}
+	if (lightJobs.empty()) lightJobs.push_back(accumulate);
+
+	return { frameGraph.Add([this]() { indirectGenTimer.End(); }, lightJobs) };
 }
 
-void Raytracer::MainDirectPass(Scene& scene, const mat4x4& projInv, const mat4x4& viewInv) {
+void Raytracer::MainDirectPass(Scene& scene, const mat4x4& projInv, const mat4x4& viewInv, std::span<const TaskGraph::Node> lightJobs) {
 
 	// Tiling and downsampling parameters for this pass
 	constexpr int sizeDiv = 1;
 	constexpr int tileSize = 4;
-	const int scaledWidth = window->width / sizeDiv;
-	const int scaledHeight = window->height / sizeDiv;
+	const int scaledWidth = traceWidth / sizeDiv;
+	const int scaledHeight = traceHeight / sizeDiv;
 	const int numScaledXtiles = scaledWidth / tileSize;
 	const int numScaledYtiles = scaledHeight / tileSize;
 
-	// Main scene trace pass
-	sceneTraceTimer.Start();
-	concurrency::parallel_for(0, numScaledXtiles * numScaledYtiles, [&](const int tile) {
-		int tileX = tile % numScaledXtiles;
-		int tileY = tile / numScaledXtiles;
+	// Primary ray cones start at the camera with a pixel's worth of spread
+	const float coneSpread = scene.camera.PixelSpread(scaledHeight);
+
+	// Trace straight to the texture at full res
+	Color* target = traceWidth == width && traceHeight == height ? textureBuffer : traceBuffer.data();
+
+	// Main scene trace pass, shading samples every light's buffers
+	frameGraph.Add([=, this, &scene]() {
+		sceneTraceTimer.Start();
 
-		for (int j = 0; j < tileSize; j++) {
-			for (int i = 0; i < tileSize; i++) {
-				float xcoord = (float)(tileX * tileSize + i) / (float)window->width;
-				float ycoord = (float)(tileY * tileSize + j) / (float)window->height;
-				int textureIndex = tileX * tileSize + i + ((tileY * tileSize + j) * window->width);
+		if (useWavefront) {
+			wavefront.Render(*this, scene, projInv, viewInv, target, scaledWidth, scaledHeight, tileSize, sortRays, raySortTimer);
+			sceneTraceTimer.End();
+			return;
+		}
+
+		concurrency::parallel_for(0, numScaledXtiles * numScaledYtiles, [&](const int tile) {
+			int tileX = tile % numScaledXtiles;
+			int tileY = tile / numScaledXtiles;
+
+			for (int j = 0; j < tileSize; j++) {
+				for (int i = 0; i < tileSize; i++) {
+					float xcoord = (float)(tileX * tileSize + i) / (float)scaledWidth;
+					float ycoord = (float)(tileY * tileSize + j) / (float)scaledHeight;
+					int textureIndex = tileX * tileSize + i + ((tileY * tileSize + j) * scaledWidth);
+
+					// Create view ray from proj/view matrices
+					vec2 pixel = vec2(xcoord, ycoord) * 2.0f - 1.0f;
+					vec4 px = vec4(pixel, 0.0f, 1.0f);
+
+					px = projInv * px;
+					px.w = 0.0f;
+					vec3 dir = viewInv * px;
+					dir = normalize(dir);
+
+					// Trace the scene
+					Ray ray{ .ro = scene.camera.transform.position, .rd = dir, .inv_rd = 1.0f / dir, .mask = std::numeric_limits<int>::min(), .coneSpread = coneSpread };
+					TraceData data = TraceData::Default;
+					vec4 result = TracePath(scene, ray, data);
+
+					target[textureIndex] = Color::FromVec(result);
+				}
+			}
+		});
+
+		sceneTraceTimer.End();
+	}, lightJobs);
+}
+
+void Raytracer::ProgressivePass(Scene& scene, const mat4x4& projInv, const mat4x4& viewInv, std::span<const TaskGraph::Node> lightJobs, int block) {
+
+	// Pixels on this level's block grid that weren't on the previous level's, each fills its block until finer levels overwrite it
+	// A block never contains pixels of earlier levels other than its own corner, so traced pixels stay as they are
+	const int coarser = block == PROGRESSIVE_BLOCK ? 0 : block * 2;
+	const int blocksX = (width + block - 1) / block;
+	const int blocksY = (height + block - 1) / block;
+
+	// Every pixel ends up traced at full res so cones don't care about the level
+	const float coneSpread = scene.camera.PixelSpread(height);
+
+	assert(progressiveBuffer.size() == (size_t)width * height);
+	Color* target = progressiveBuffer.data();
+
+	// Wavefront mode isn't used here, its queues are built around full tiles
+	frameGraph.Add([=, this, &scene]() {
+		sceneTraceTimer.Start();
+
+		concurrency::parallel_for(0, blocksY, [&](int by) {
+			for (int bx = 0; bx < blocksX; bx++) {
+				const int x = bx * block, y = by * block;
+				if (coarser != 0 && x % coarser == 0 && y % coarser == 0) continue; // Traced on an earlier level
+
+				float xcoord = (float)x / (float)width;
+				float ycoord = (float)y / (float)height;
 
 				// Create view ray from proj/view matrices
 				vec2 pixel = vec2(xcoord, ycoord) * 2.0f - 1.0f;
@@ -493,19 +755,155 @@ void Raytracer::MainDirectPass(Scene& scene, const mat4x4& projInv, const mat4x4
 				dir = normalize(dir);
 
 				// Trace the scene
-				Ray ray{ .ro = scene.camera.transform.position, .rd = dir, .inv_rd = 1.0f / dir, .mask = std::numeric_limits<int>::min() };
+				Ray ray{ .ro = scene.camera.transform.position, .rd = dir, .inv_rd = 1.0f / dir, .mask = std::numeric_limits<int>::min(), .coneSpread = coneSpread };
 				TraceData data = TraceData::Default;
-				vec4 result = TracePath(scene, ray, data);
+				const Color result = Color::FromVec(TracePath(scene, ray, data));
 
-				textureBuffer[textureIndex] = Color::FromVec(result);
+				for (int j = y; j < std::min(y + block, height); j++)
+					for (int i = x; i < std::min(x + block, width); i++)
+						target[j * width + i] = result;
 			}
+		});
+
+		sceneTraceTimer.End();
+	}, lightJobs);
+}
+
+void Raytracer::UpdateTraceResolution(bool fullRes) {
+
+	// Full scale traces the window size as is, rounding it down would just blur the whole frame
+	if (!dynamicResolution || fullRes || resolutionScale >= 1.0f) {
+		resolutionScale = 1.0f;
+		traceWidth = width;
+		traceHeight = height;
+		return;
+	}
+
+	// Multiples of 16 so the quarter res prepasses still split into whole 4x4 tiles
+	constexpr int align = 16;
+	traceWidth = std::max(align, (int)(width * resolutionScale) / align * align);
+	traceHeight = std::max(align, (int)(height * resolutionScale) / align * align);
+
+	if (traceWidth != width || traceHeight != height)
+		traceBuffer.resize(traceWidth * traceHeight);
+}
+
+void Raytracer::UpdateResolutionScale(double traceTime) {
+
+	if (!dynamicResolution) return;
+
+	// Trace time scales about linearly with pixel count, so per axis scale goes with the square root
+	double ratio = (frameBudgetMs / 1000.0) / std::max(traceTime, 0.0001);
+	float target = resolutionScale * (float)std::sqrt(ratio);
+
+	// Damped so a single slow frame doesn't make the resolution jump around
+	resolutionScale = glm::clamp(Utils::Lerp(resolutionScale, target, 0.25f), minResolutionScale, 1.0f);
+}
+
+void Raytracer::Upscale() {
+
+	const float scaleX = (float)traceWidth / (float)width;
+	const float scaleY = (float)traceHeight / (float)height;
+
+	concurrency::parallel_for(0, height, [&](int y) {
+
+		// Sample position in trace space, pixel centers aligned
+		float sy = glm::clamp(((float)y + 0.5f) * scaleY - 0.5f, 0.0f, (float)(traceHeight - 1));
+		int y0 = (int)sy;
+		int y1 = std::min(y0 + 1, traceHeight - 1);
+		int fy = (int)((sy - (float)y0) * 256.0f);
+
+		const Color* row0 = traceBuffer.data() + y0 * traceWidth;
+		const Color* row1 = traceBuffer.data() + y1 * traceWidth;
+		Color* out = textureBuffer + y * width;
+
+		for (int x = 0; x < width; x++) {
+			float sx = glm::clamp(((float)x + 0.5f) * scaleX - 0.5f, 0.0f, (float)(traceWidth - 1));
+			int x0 = (int)sx;
+			int x1 = std::min(x0 + 1, traceWidth - 1);
+			int fx = (int)((sx - (float)x0) * 256.0f);
+
+			// 8 bit fixed point bilinear
+			auto blend = [&](uint8_t c00, uint8_t c10, uint8_t c01, uint8_t c11) {
+				int top = c00 * (256 - fx) + c10 * fx;
+				int bottom = c01 * (256 - fx) + c11 * fx;
+				return (uint8_t)((top * (256 - fy) + bottom * fy) >> 16);
+			};
+			const Color& a = row0[x0], & b = row0[x1], & c = row1[x0], & d = row1[x1];
+			out[x] = Color(blend(a.r, b.r, c.r, d.r), blend(a.g, b.g, c.g, d.g), blend(a.b, b.b, c.b, d.b), blend(a.a, b.a, c.a, d.a));
 		}
 	});
+}
 
-	sceneTraceTimer.End();
+void Raytracer::UpdateMemoryStats(const Scene& scene) {
+
+	// Walks sizes only, cheap enough to do every frame
+	size_t meshes = 0, textures = TexturePages::ResidentBytes(), bvhs = 0, lightBuffers = 0;
+	for (const auto& slot : Assets::Meshes)
+		if (const Mesh* mesh = slot.get()) meshes += mesh->MemoryUsage();
+	for (const auto& slot : Assets::Textures)
+		if (const Texture* texture = slot.get()) textures += texture->MemoryUsage();
+
+	for (const auto& obj : scene.entities) {
+		bvhs += obj->bvh.MemoryUsage();
+		for (const auto& lod : obj->lods) bvhs += lod.bvh.MemoryUsage();
+		for (const auto& cache : obj->reflectionCaches)
+			bvhs += cache.dirs.capacity() * sizeof(vec3) + cache.facing.capacity() + cache.activeNodes.capacity();
+	}
+
+	for (const auto& light : scene.lights)
+		lightBuffers += light.lightBvh.MemoryUsage() + light.indirectBvh.MemoryUsage() + light.irradianceCache.MemoryUsage()
+			+ light._indirectTempBuffer.capacity() * sizeof(LightbufferPt);
+
+	MemoryStats::Set(MemoryStats::Meshes, meshes);
+	MemoryStats::Set(MemoryStats::Textures, textures);
+	MemoryStats::Set(MemoryStats::Bvhs, bvhs);
+	MemoryStats::Set(MemoryStats::LightBuffers, lightBuffers);
+	MemoryStats::Set(MemoryStats::FrameTemp, FrameArena::UsedBytes());
 }
 
 void Raytracer::RenderScene(Scene& scene) {
+	WaitForFrame();
+	TraceScene(scene);
+
+	// Nothing to present to
+	if (!headless) Blit(finished);
+}
+
+void Raytracer::RenderSceneAsync(Scene& scene) {
+	WaitForFrame();
+
+	// Last frame goes to bgfx now and gets uploaded in the next bgfx::frame(), which overlaps with the trace below
+	if (!headless && finished.buffer != nullptr) Blit(finished);
+
+	frameInFlight = true;
+	frameTask.run([this, &scene]() { TraceScene(scene); });
+}
+
+void Raytracer::WaitForFrame() {
+	if (!frameInFlight) return;
+	frameTask.wait();
+	frameInFlight = false;
+}
+
+void Raytracer::TraceScene(Scene& scene) {
+
+	const double frameStart = Time::GetAccurateTime();
+
+	// Read once, everything below has to agree on the mode for the whole frame
+	const bool isProgressive = progressive;
+
+	// Next output buffer, the ones before it may still be referenced by bgfx
+	outputIndex = (outputIndex + 1) % OUTPUT_BUFFERS;
+	textureBuffer = outputBuffers[outputIndex];
+
+	// Nothing is sampling textures between frames, safe to evict pages
+	TexturePages::Trim();
+
+	// Last frame's transient buffers are done with too
+	FrameArena::Reset();
+
+	UpdateTraceResolution(isProgressive);
 
 	// Matrices
 	const Transform& camTransform = scene.camera.transform;
@@ -513,30 +911,75 @@ void Raytracer::RenderScene(Scene& scene) {
 	vec3 fwd = camTransform.Forward();
 	vec3 up = camTransform.Up();
 	mat4x4 view = glm::lookAt(camTransform.position, camTransform.position + fwd, up);
-	mat4x4 proj = glm::perspectiveFov(radians(scene.camera.fov), (float)window->width, (float)window->height, scene.camera.nearClip, scene.camera.farClip);
+	mat4x4 proj = glm::perspectiveFov(radians(scene.camera.fov), (float)width, (float)height, scene.camera.nearClip, scene.camera.farClip);
 	mat4x4 viewInv = inverse(view);
 	mat4x4 projInv = inverse(proj);
 
-	// Backbuffer
-	const bgfx::Memory* mem = bgfx::makeRef(textureBuffer, (uint32_t)textureBufferSize);
+	// Progressive image is only valid for the view it was started with, turning the mode off drops it so it starts over next time
+	if (!isProgressive) progressiveBuffer.clear();
+	else if (view != progressiveView || proj != progressiveProj || progressiveBuffer.size() != (size_t)width * height) {
+		progressiveBuffer.resize((size_t)width * height);
+		progressiveBlock = PROGRESSIVE_BLOCK;
+		progressiveView = view;
+		progressiveProj = proj;
+	}
+
+	// Fully refined, nothing to trace
+	const int block = isProgressive ? progressiveBlock : 0;
+	if (isProgressive && block == 0) {
+		std::copy(progressiveBuffer.begin(), progressiveBuffer.end(), textureBuffer);
+		finished = { .buffer = textureBuffer, .view = view, .proj = proj };
+		return;
+	}
 
 	// Clear buffers
+	// Indirect bvhs persist between indirect updates
 	for (auto& light : scene.lights) {
-		light.indirectBvh.Clear();
 		light.lightBvh.Clear();
 	}
 
+	// Passes only add their jobs here, everything runs in frameGraph.Run() as soon as its inputs are done
+	frameGraph.Clear();
+
 	// Calculate downsampled lit areas to use for smoothing shadow
-	SmoothShadowsPass(scene, projInv, viewInv);
+	const auto shadowJobs = SmoothShadowsPass(scene, projInv, viewInv);
 
 	// Calculate 1 bounce indirect lighting cast by objects
-	IndirectLightingPass(scene, projInv, viewInv);
+	const auto indirectJobs = IndirectLightingPass(scene, projInv, viewInv, shadowJobs);
 
 	// Draw the main screen buffer
-	MainDirectPass(scene, projInv, viewInv);
+	std::vector<TaskGraph::Node> lightJobs = shadowJobs;
+	lightJobs.insert(lightJobs.end(), indirectJobs.begin(), indirectJobs.end());
+	if (isProgressive) {
+		ProgressivePass(scene, projInv, viewInv, lightJobs, block);
+		progressiveBlock = block / 2;
+	}
+	else MainDirectPass(scene, projInv, viewInv, lightJobs);
+
+	frameGraph.Run();
+
+	// Progressive image persists between frames, output buffers rotate
+	if (isProgressive)
+		std::copy(progressiveBuffer.begin(), progressiveBuffer.end(), textureBuffer);
+
+	// Stretch to output res if we traced lower
+	else if (traceWidth != width || traceHeight != height)
+		Upscale();
+
+	UpdateResolutionScale(Time::GetAccurateTime() - frameStart);
+	UpdateMemoryStats(scene);
+
+	// Sorts happen once per indirect update + once per wavefront bounce, the timer shows their total per frame
+	raySortTimer.Commit();
+
+	finished = { .buffer = textureBuffer, .view = view, .proj = proj };
+}
+
+void Raytracer::Blit(const OutputFrame& frame) {
 
 	// Update gpu texture
-	bgfx::updateTexture2D(texture, 0, 0, 0, 0, window->width, window->height, mem);
+	const bgfx::Memory* mem = bgfx::makeRef(frame.buffer, (uint32_t)textureBufferSize);
+	bgfx::updateTexture2D(texture, 0, 0, 0, 0, width, height, mem);
 
 	// Render a single triangle as a fullscreen pass
 	if (bgfx::getAvailTransientVertexBuffer(3, vtxLayout) == 3) {
@@ -549,11 +992,11 @@ void Raytracer::RenderScene(Scene& scene) {
 		// Vertices
 		const Color clr(0x00, 0x00, 0x00, 0xff);
 		vertex[0] = PosColorTexCoord0Vertex{ .pos = vec3(0.0f, 0.0f, 0.0f),				.rgba = clr, .uv = vec2(0.0f, 0.0f) };
-		vertex[1] = PosColorTexCoord0Vertex{ .pos = vec3(window->width, 0.0f, 0.0f),	.rgba = clr, .uv = vec2(-2.0f, 0.0f) };
-		vertex[2] = PosColorTexCoord0Vertex{ .pos = vec3(0.0f, window->height, 0.0f),	.rgba = clr, .uv = vec2(0.0f, 2.0f) };
+		vertex[1] = PosColorTexCoord0Vertex{ .pos = vec3(width, 0.0f, 0.0f),	.rgba = clr, .uv = vec2(-2.0f, 0.0f) };
+		vertex[2] = PosColorTexCoord0Vertex{ .pos = vec3(0.0f, height, 0.0f),	.rgba = clr, .uv = vec2(0.0f, 2.0f) };
 
 		// Set data and submit
-		bgfx::setViewTransform(VIEW_LAYER, &view, &proj);
+		bgfx::setViewTransform(VIEW_LAYER, &frame.view, &frame.proj);
 		bgfx::setTexture(0, u_texture, texture);
 		bgfx::setState(BGFX_STATE_WRITE_RGB | BGFX_STATE_WRITE_A);
 		bgfx::setVertexBuffer(0, &vb);
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <bgfx/bgfx.h>
+#include <ppl.h> // Task group
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
@@ -8,9 +9,11 @@
 #include "Engine/Utils.h"
 #include "Engine/Timer.h"
 #include "Engine/BvhPoint.h"
+#include "Engine/TaskGraph.h"
 #include "Game/Entity.h"
 #include "Game/Scene.h"
 #include "Rendering/RayResult.h"
+#include "Rendering/WavefrontTracer.h"
 
 // Raytracer for a given scene
 class Raytracer {
@@ -20,11 +23,51 @@ public:
 	const bgfx::ViewId VIEW_LAYER = 0;
 
 	// Profiling timers
-	Timer sceneTraceTimer, lightBufferSampleTimer, lightBufferGenTimer, indirectSampleTimer, indirectGenTimer;
+	Timer sceneTraceTimer, lightBufferSampleTimer, lightBufferGenTimer, indirectSampleTimer, indirectGenTimer, raySortTimer;
+
+	// Traces the main pass stage by stage with ray queues instead of recursing per pixel
+	bool useWavefront = false;
+
+	// Progressive refinement, the first frame traces 1 pixel per 8x8 block and every frame after fills in the pixels in between
+	// Starts over when the camera moves, once every pixel is traced the image is kept until it does
+	bool progressive = false;
+
+	// Block size the first progressive frame traces at
+	static constexpr int PROGRESSIVE_BLOCK = 8;
+
+	// Sorts queued secondary rays by direction and origin before tracing them
+	bool sortRays = false;
+
+	// Output resolution
+	int width = 0, height = 0;
+
+	// Dynamic resolution, scales the trace resolution every frame to stay inside the frame time budget
+	bool dynamicResolution = false;
+	float frameBudgetMs = 33.0f;
+	float minResolutionScale = 0.25f;
+	float resolutionScale = 1.0f; // Current per axis scale of the trace resolution
+
+	// Internal resolution every pass traces at, upscaled to the output resolution if smaller
+	int traceWidth = 0, traceHeight = 0;
+
+	// Indirect lighting resolution divisor relative to the trace resolution
+	int indirectSizeDiv = 4;
+
+	// Indirect lighting is updated every N frames, in between the previous result is reused
+	int indirectInterval = 1;
+
+	// Splits indirect tiles into N interleaved sets and refreshes 1 set per update
+	int indirectTileSets = 1;
+
+	// Keeps indirect results in a world space cache per light so areas outside the last update still get indirect light
+	bool useIrradianceCache = true;
 
 	// Initializes a new raytracer for given window
 	void Create(const Window& window);
 
+	// Initializes a raytracer that only renders to its cpu buffer, no window or bgfx required (benchmarks)
+	void CreateHeadless(int width, int height);
+
 	// Shoots a ray against the scene and returns information about what we hit if anything
 	RayResult RaycastScene(const Scene& scene, const Ray& ray) const;
 
@@ -37,25 +80,97 @@ public:
 	// Renders given scene to a texture and blits on screen
 	void RenderScene(Scene& scene);
 
+	// Pipelined RenderScene, blits the last finished frame and starts tracing the scene on worker threads
+	// Returns straight away so bgfx::frame() can upload and present while the next frame traces, scene must be left alone until WaitForFrame()
+	void RenderSceneAsync(Scene& scene);
+
+	// Blocks until the frame started by RenderSceneAsync is traced
+	void WaitForFrame();
+
+	// Output buffers frames rotate through, bgfx reads a referenced buffer up to 2 frame() calls after it's handed over
+	static constexpr int OUTPUT_BUFFERS = 3;
+
 	~Raytracer() {
-		bgfx::destroy(texture);
-		bgfx::destroy(u_texture);
-		delete textureBuffer;
+		WaitForFrame();
+		if (!headless) {
+			bgfx::destroy(texture);
+			bgfx::destroy(u_texture);
+		}
+		for (Color* buffer : outputBuffers) delete[] buffer;
 	}
 
 private:
 
-	// Calculates indirect lighting into each light's own BVH
-	void IndirectLightingPass(Scene& scene, const glm::mat4x4& projInv, const glm::mat4x4& viewInv);
+	// Runs every pass for the scene into the next output buffer, result goes to finished
+	void TraceScene(Scene& scene);
+
+	// Traced output buffer and the matrices it was traced with
+	struct OutputFrame {
+		const Color* buffer = nullptr;
+		glm::mat4x4 view, proj;
+	};
+
+	// Hands a finished frame to bgfx and draws it as a fullscreen pass
+	void Blit(const OutputFrame& frame);
+
+	// Passes add their jobs to frameGraph and return the jobs that finish their per light buffers, empty if nothing was added
+
+	// Calculates indirect lighting into each light's own BVH, light rays wait for shadowJobs
+	std::vector<TaskGraph::Node> IndirectLightingPass(Scene& scene, const glm::mat4x4& projInv, const glm::mat4x4& viewInv, std::span<const TaskGraph::Node> shadowJobs);
 
 	// Calculates screen space areas that are lit and saves it to each light's own BVH
-	void SmoothShadowsPass(Scene& scene, const glm::mat4x4& projInv, const glm::mat4x4& viewInv);
+	std::vector<TaskGraph::Node> SmoothShadowsPass(Scene& scene, const glm::mat4x4& projInv, const glm::mat4x4& viewInv);
+
+	// Calculates the main per pixel lighting for the scene once lightJobs are done
+	void MainDirectPass(Scene& scene, const glm::mat4x4& projInv, const glm::mat4x4& viewInv, std::span<const TaskGraph::Node> lightJobs);
+
+	// Main pass for progressive mode, traces the pixels of refinement level block into progressiveBuffer
+	void ProgressivePass(Scene& scene, const glm::mat4x4& projInv, const glm::mat4x4& viewInv, std::span<const TaskGraph::Node> lightJobs, int block);
+
+	// Picks this frame's trace resolution from resolutionScale, fullRes for modes that need output resolution (progressive)
+	void UpdateTraceResolution(bool fullRes);
+
+	// Moves resolutionScale towards the frame budget based on how long the last frame took to trace
+	void UpdateResolutionScale(double traceTime);
 
-	// Calculates the main per pixel lighting for the scene
-	void MainDirectPass(Scene& scene, const glm::mat4x4& projInv, const glm::mat4x4& viewInv);
+	// Bilinearly upscales the trace buffer into the texture buffer
+	void Upscale();
 
-	// Temp buffer used during shadow accelerator sampling
-	std::vector<glm::vec4> screenTempBuffer;
+	// Reports memory use per subsystem to MemoryStats as held at the end of this frame
+	void UpdateMemoryStats(const Scene& scene);
+
+	// Jobs of the frame being traced
+	TaskGraph frameGraph;
+
+	// Main pass target when tracing below output resolution
+	std::vector<Color> traceBuffer;
+
+	// Progressive mode image at output resolution, the block size the next frame traces at (0 = done) and the view it's for
+	std::vector<Color> progressiveBuffer;
+	int progressiveBlock = 0;
+	glm::mat4x4 progressiveView, progressiveProj;
+
+	// Queue based tracer for the main pass
+	WavefrontTracer wavefront;
+
+	// Light ray queue of the indirect pass, segmented per tile, and the computed color of each ray
+	struct IndirectRay {
+		Ray ray;
+		glm::vec3 reflectPt; // Point on obj the ray should hit
+		const Entity* obj;
+		float intensity;
+		int textureIndex;
+		int light;
+	};
+	std::vector<IndirectRay> indirectRays;
+	std::vector<glm::vec4> indirectRayColors;
+	std::vector<std::vector<IndirectRay>> indirectTileRays;
+	std::vector<std::vector<const Entity*>> indirectTileCandidates; // Reflectors close enough to each tile
+	std::vector<int> indirectTileOffsets;
+	std::vector<uint64_t> indirectTraceOrder;
+	int indirectWidth = 0, indirectHeight = 0; // Resolution the indirect buffers were made at
+	int indirectFrame = 0;
+	std::vector<std::pair<Entity*, int>> reflectionCacheJobs; // Mesh + light index pairs whose reflection cache is stale
 
 	// The texture the raytracer updates
 	bgfx::TextureHandle texture;
@@ -65,12 +180,20 @@ private:
 	// GPU Shader (just blits an array on the screen)
 	bgfx::ProgramHandle program;
 
-	// Texture data buffer
-	Color* textureBuffer;
+	// Texture data buffers, textureBuffer is the one currently traced to
+	Color* outputBuffers[OUTPUT_BUFFERS] = {};
+	Color* textureBuffer = nullptr;
 	uint32_t textureBufferSize;
+	int outputIndex = 0;
+
+	// Async trace of the current frame, the last finished buffer is blitted next time
+	concurrency::task_group frameTask;
+	bool frameInFlight = false;
+	OutputFrame finished;
 
-	// Current window
-	const Window* window;
+	// Current window, null if headless
+	const Window* window = nullptr;
+	bool headless = false;
 
 	// Vertex layout for the full screen pass
 	struct PosColorTexCoord0Vertex {
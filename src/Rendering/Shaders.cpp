@@ -15,12 +15,12 @@ vec4 Shaders::Textured(const Scene& scene, const RayResult& rayResult, const v2f
 	// Base color
 	if (rayResult.obj->HasMesh()) {
 
-		const auto& meshPtr = Assets::Meshes[rayResult.obj->meshHandle];
+		const auto& meshPtr = rayResult.obj->GetMesh();
 		int materialID = meshPtr->materialIDs[rayResult.triIndex / 3];
 		const Material& material = rayResult.obj->materials[materialID];
 
 		if (material.HasTexture())
-			c = Assets::Textures[material.textureHandle]->SampleUVClamp(input.uv).ToVec4() * material.color;
+			c = Assets::Textures[material.textureHandle]->Sample(input.uv, input.uvFootprint) * material.color;
 		else
 			c = Colors::Cyan.ToVec4();
 	}
@@ -119,7 +119,8 @@ void Shaders::LightLoop(const Scene& scene, const RayResult& rayResult, const v2
 		light.CalcGenericLighting(input.worldPosition, input.worldNormal, atten, nl);
 
 		float shadow = 1.0f;
-		if (data.HasFlag(TraceData::Shadows)) shadow = CalculateShadow(scene, light, rayResult, input, data);
+		if (data.HasFlag(TraceData::Shadows))
+			shadow = data.shadows != nullptr ? data.shadows[i] : CalculateShadow(scene, light, rayResult, input, data);
 
 		float shading = shadow * nl;
 
@@ -209,7 +210,10 @@ float Shaders::SampleSmoothShadow(const Light& light, const v2f& input, const fl
 // Samples GI from bvh for this position
 vec4 Shaders::SampleGI(const Scene& scene, const Light& light, const RayResult& rayResult, const v2f& input, const TraceData& data) {
 
-	if (!light.indirectBvh.Exists()) return vec4(0.0f);
+	// Nothing traced this update, fall back to whatever the world cache has
+	vec4 cached;
+	if (!light.indirectBvh.Exists())
+		return light.irradianceCache.Sample(input.worldPosition, input.worldNormal, cached) ? cached : vec4(0.0f);
 
 	constexpr int N = 4; // Num closest samples to average
 	constexpr float distLim = 1.0f; // Range limit for searches
@@ -226,12 +230,19 @@ vec4 Shaders::SampleGI(const Scene& scene, const Light& light, const RayResult&
 
 	// Average N nearest samples
 	vec4 ret = vec4(0.0f);
+	bool anyInRange = false;
 	for (int i = 0; i < N; i++) {
 		dist[i] = 1.0f - Utils::InvLerpClamp(sqrt(dist[i]), depthOffset + 0.005f, depthOffset + 0.01f);
+		anyInRange |= dist[i] > 0.0f;
 		// Surface receiver normal has to be similar to bvh points saved normal in order to receive indirect
 		float anglePenalty = max(0.0f, dot(input.worldNormal, datas[i].payload.nrm));
 		ret += std::bit_cast<Color>(datas[i].payload.clr).ToVec4() * dist[i] * anglePenalty;
 	}
+
+	// Pts only exist where indirect was found this update, outside them the cache knows about offscreen/older areas
+	if (!anyInRange && light.irradianceCache.Sample(input.worldPosition, input.worldNormal, cached))
+		return cached;
+
 	ret /= (float)N;
 	return ret;
 }
\ No newline at end of file
@@ -25,10 +25,10 @@ public:
 	// (Debug) Generic debug
 	static glm::vec4 Debug(		const Scene& scene, const RayResult& rayResult, const v2f& input, const TraceData& data);
 
-private:
-	
 	// Samples N closest points on a bvh for nearby lit points of given light
 	static float SampleSmoothShadow(const Light& light, const v2f& input, const float& blockerDist);
+
+private:
 	
 	// Samples GI from bvh for this position
 	static glm::vec4 SampleGI(const Scene& scene, const Light& light, const RayResult& rayResult, const v2f& input, const TraceData& data);
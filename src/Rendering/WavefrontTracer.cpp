@@ -0,0 +1,310 @@
+#include "WavefrontTracer.h"
+
+#include <ppl.h> // Parallel for
+#include <atomic>
+
+#include "Game/RenderedMesh.h"
+#include "Rendering/Raytracer.h"
+#include "Rendering/RaySort.h"
+#include "Rendering/Shaders.h"
+
+using namespace glm;
+
+void WavefrontTracer::Render(const Raytracer& raytracer, const Scene& scene, const mat4x4& projInv, const mat4x4& viewInv,
+	Color* target, int width, int height, int tileSize, bool sortRays, Timer& sortTimer) {
+
+	this->width = width;
+	this->height = height;
+	this->tileSize = tileSize;
+	numXtiles = width / tileSize;
+	numLights = (int)scene.lights.size();
+	const int numTiles = numXtiles * (height / tileSize);
+
+	// Screen is processed in batches of tiles so the queues never grow past a fixed size
+	for (firstTile = 0; firstTile < numTiles; firstTile += TILES_PER_BATCH) {
+		batchTiles = std::min(TILES_PER_BATCH, numTiles - firstTile);
+
+		GeneratePrimary(scene, projInv, viewInv);
+
+		// Each iteration is one bounce, rays spawned by shading go to the next queue
+		// Primary rays are coherent already so only later bounces get sorted
+		for (int depth = 0; depth <= MAX_DEPTH && !queue.rays.empty(); depth++) {
+			const bool sort = sortRays && depth > 0;
+			TraceQueue(raytracer, scene, sort, sortTimer);
+			TraceShadows(raytracer, scene, sort, sortTimer);
+			Shade(scene, nextQueue);
+			std::swap(queue, nextQueue);
+		}
+
+		// Resolve the batch to the target
+		concurrency::parallel_for(0, batchTiles, [&](int batchTile) {
+			int tile = firstTile + batchTile;
+			int tileX = tile % numXtiles;
+			int tileY = tile / numXtiles;
+
+			for (int j = 0; j < tileSize; j++) {
+				for (int i = 0; i < tileSize; i++) {
+					int textureIndex = tileX * tileSize + i + ((tileY * tileSize + j) * width);
+					target[textureIndex] = Color::FromVec(accumulated[batchTile * tileSize * tileSize + j * tileSize + i]);
+				}
+			}
+		});
+	}
+}
+
+void WavefrontTracer::GeneratePrimary(const Scene& scene, const mat4x4& projInv, const mat4x4& viewInv) {
+
+	const int raysPerTile = tileSize * tileSize;
+	queue.rays.resize(batchTiles * raysPerTile);
+	queue.tileOffsets.resize(batchTiles + 1);
+	accumulated.resize(batchTiles * raysPerTile);
+
+	// Primary ray cones start at the camera with a pixel's worth of spread
+	const float coneSpread = scene.camera.PixelSpread(height);
+
+	concurrency::parallel_for(0, batchTiles, [&](int batchTile) {
+		int tile = firstTile + batchTile;
+		int tileX = tile % numXtiles;
+		int tileY = tile / numXtiles;
+
+		queue.tileOffsets[batchTile] = batchTile * raysPerTile;
+
+		for (int j = 0; j < tileSize; j++) {
+			for (int i = 0; i < tileSize; i++) {
+				float xcoord = (float)(tileX * tileSize + i) / (float)width;
+				float ycoord = (float)(tileY * tileSize + j) / (float)height;
+				int pixel = batchTile * raysPerTile + j * tileSize + i;
+
+				// Create view ray from proj/view matrices
+				vec2 uv = vec2(xcoord, ycoord) * 2.0f - 1.0f;
+				vec4 px = vec4(uv, 0.0f, 1.0f);
+
+				px = projInv * px;
+				px.w = 0.0f;
+				vec3 dir = viewInv * px;
+				dir = normalize(dir);
+
+				queue.rays[pixel] = QueuedRay{
+					.ray = Ray{ .ro = scene.camera.transform.position, .rd = dir, .inv_rd = 1.0f / dir, .mask = std::numeric_limits<int>::min(), .coneSpread = coneSpread },
+					.weight = 1.0f,
+					.cumulativeDepth = 0.0f,
+					.pixel = pixel,
+					.depth = 0
+				};
+				accumulated[pixel] = vec4(0.0f);
+			}
+		}
+	});
+
+	queue.tileOffsets[batchTiles] = batchTiles * raysPerTile;
+}
+
+void WavefrontTracer::TraceQueue(const Raytracer& raytracer, const Scene& scene, bool sort, Timer& sortTimer) {
+
+	const int numRays = (int)queue.rays.size();
+	hits.resize(numRays);
+	interpolated.resize(numRays);
+	shadowRays.resize((size_t)numRays * numLights);
+	activeShadows.resize(shadowRays.size());
+
+	// Queue stays segmented per tile, only the order of tracing changes
+	if (sort) {
+		sortTimer.Start();
+		traceOrder.resize(numRays);
+		concurrency::parallel_for(0, numRays, [&](int i) {
+			traceOrder[i] = RaySort::Pack(RaySort::Key(queue.rays[i].ray.rd, queue.rays[i].ray.ro, scene.bounds), i);
+		});
+		RaySort::Sort(traceOrder);
+		sortTimer.Add();
+	}
+
+	std::atomic<int> activeCount = 0;
+
+	concurrency::parallel_for(0, numRays, [&](int k) {
+
+		const int i = sort ? RaySort::Index(traceOrder[k]) : k;
+		const Ray& ray = queue.rays[i].ray;
+		const RayResult& hit = hits[i] = raytracer.RaycastScene(scene, ray);
+		ShadowRay* shadows = shadowRays.data() + (size_t)i * numLights;
+
+		if (!hit.Hit()) {
+			for (int l = 0; l < numLights; l++) shadows[l].state = ShadowRay::Unused;
+			return;
+		}
+
+		// Interpolate variables in "vertex shader"
+		const v2f& input = interpolated[i] = hit.obj->VertexShader(ray, hit);
+
+		// Same bias as Shaders::CalculateShadow
+		const vec3 bias = input.worldNormal * 0.008f;
+
+		// Queue a shadow ray for every light in range
+		for (int l = 0; l < numLights; l++) {
+			const auto& light = scene.lights[l];
+
+			if (Utils::SqrLength(input.worldPosition - light.position) > light.range * light.range) {
+				shadows[l].state = ShadowRay::Unused;
+				continue;
+			}
+
+			shadows[l] = ShadowRay{
+				.ro = input.worldPosition + bias,
+				.to = light.position,
+				.blockerDist = 0.0f,
+				.mask = hit.id,
+				.continuations = 0,
+				.state = ShadowRay::Active
+			};
+			activeShadows[activeCount++] = i * numLights + l;
+		}
+	});
+
+	activeShadows.resize(activeCount);
+}
+
+void WavefrontTracer::TraceShadows(const Raytracer& raytracer, const Scene& scene, bool sort, Timer& sortTimer) {
+
+	// Rays that hit a cutout texel go on from the hit point, the rest are done after 1 pass
+	while (!activeShadows.empty()) {
+
+		// Active list is just indices so it can be reordered directly
+		if (sort) {
+			sortTimer.Start();
+			traceOrder.resize(activeShadows.size());
+			concurrency::parallel_for(0, (int)activeShadows.size(), [&](int i) {
+				const ShadowRay& shadow = shadowRays[activeShadows[i]];
+				traceOrder[i] = RaySort::Pack(RaySort::Key(shadow.to - shadow.ro, shadow.ro, scene.bounds), activeShadows[i]);
+			});
+			RaySort::Sort(traceOrder);
+			for (size_t i = 0; i < traceOrder.size(); i++)
+				activeShadows[i] = RaySort::Index(traceOrder[i]);
+			sortTimer.Add();
+		}
+
+		nextActiveShadows.resize(activeShadows.size());
+		std::atomic<int> nextCount = 0;
+
+		concurrency::parallel_for(0, (int)activeShadows.size(), [&](int i) {
+
+			ShadowRay& shadow = shadowRays[activeShadows[i]];
+
+			vec3 dir = shadow.to - shadow.ro;
+			float dist = length(dir);
+			dir /= dist; // Normalize
+			Ray ray{ .ro = shadow.ro, .rd = dir, .inv_rd = 1.0f / dir, .mask = shadow.mask };
+			RayResult res = raytracer.RaycastScene(scene, ray);
+
+			if (!res.Hit() || res.depth >= dist - 0.001f) {
+				shadow.state = ShadowRay::Clear;
+				return;
+			}
+
+			shadow.blockerDist += res.depth;
+
+			if (res.obj->type == Entity::Type::RenderedMesh && static_cast<RenderedMesh*>(res.obj)->SampleAt(res.localPos, res.id).a == 0) {
+
+				// Passing multiple transparent things counts as lit, same inf loop safeguard as Shaders::ShadowRay
+				if (++shadow.continuations > 5) {
+					shadow.state = ShadowRay::Clear;
+					return;
+				}
+
+				shadow.ro = ray.ro + ray.rd * res.depth;
+				shadow.mask = res.triIndex;
+				nextActiveShadows[nextCount++] = activeShadows[i];
+				return;
+			}
+
+			shadow.state = ShadowRay::Blocked;
+		});
+
+		nextActiveShadows.resize(nextCount);
+		std::swap(activeShadows, nextActiveShadows);
+	}
+}
+
+void WavefrontTracer::Shade(const Scene& scene, RayQueue& next) {
+
+	const int numTiles = (int)queue.tileOffsets.size() - 1;
+	tileSpawned.resize(numTiles);
+	shadowTerms.resize(shadowRays.size());
+
+	// Tiles own their pixels so accumulating needs no synchronization
+	concurrency::parallel_for(0, numTiles, [&](int tile) {
+
+		auto& spawned = tileSpawned[tile];
+		spawned.clear();
+
+		for (int i = queue.tileOffsets[tile]; i < queue.tileOffsets[tile + 1]; i++) {
+
+			const QueuedRay& queued = queue.rays[i];
+			const RayResult& hit = hits[i];
+
+			// If we hit nothing, draw "Skybox", same as TracePath
+			if (!hit.Hit()) {
+				accumulated[queued.pixel] += vec4(0.3f, 0.3f, 0.6f, 1.0f) * queued.weight;
+				continue;
+			}
+
+			const v2f& input = interpolated[i];
+
+			// Resolve shadows of this hit, blocked ones are smoothed like in Shaders::CalculateShadow
+			float* shadows = shadowTerms.data() + (size_t)i * numLights;
+			for (int l = 0; l < numLights; l++) {
+				const ShadowRay& shadow = shadowRays[(size_t)i * numLights + l];
+				shadows[l] = shadow.state == ShadowRay::Blocked ? Shaders::SampleSmoothShadow(scene.lights[l], input, shadow.blockerDist) : 1.0f;
+			}
+
+			TraceData data = TraceData::Default;
+			data.cumulativeDepth = queued.cumulativeDepth + hit.depth;
+			data.recursionDepth = queued.depth;
+			data.shadows = shadows;
+
+			// Shade below in "fragment shader"
+			vec4 c = hit.obj->FragmentShader(scene, hit, input, data);
+
+			// Split the weight between this surface, the reflection and whatever is behind it
+			const bool canBounce = queued.depth < MAX_DEPTH;
+			const float reflectivity = canBounce ? hit.obj->GetMaterial(hit.triIndex).reflectivity : 0.0f;
+			const float alpha = canBounce && c.a < 0.99f ? c.a : 1.0f;
+
+			accumulated[queued.pixel] += c * (queued.weight * alpha * (1.0f - reflectivity));
+
+			if (reflectivity != 0.0f) {
+				vec3 newRd = reflect(queued.ray.rd, hit.obj->transform.rotation * hit.faceNormal);
+				spawned.push_back(QueuedRay{
+					.ray = Ray{ .ro = input.worldPosition, .rd = newRd, .inv_rd = 1.0f / newRd, .mask = hit.id,
+						.coneWidth = queued.ray.ConeWidthAt(hit.depth), .coneSpread = queued.ray.coneSpread },
+					.weight = queued.weight * alpha * reflectivity,
+					.cumulativeDepth = data.cumulativeDepth,
+					.pixel = queued.pixel,
+					.depth = queued.depth + 1
+				});
+			}
+
+			if (alpha < 1.0f) {
+				vec3 hitPt = queued.ray.ro + queued.ray.rd * hit.depth;
+				spawned.push_back(QueuedRay{
+					.ray = Ray{ .ro = hitPt, .rd = queued.ray.rd, .inv_rd = queued.ray.inv_rd, .mask = hit.id,
+						.coneWidth = queued.ray.ConeWidthAt(hit.depth), .coneSpread = queued.ray.coneSpread },
+					.weight = queued.weight * (1.0f - alpha),
+					.cumulativeDepth = data.cumulativeDepth,
+					.pixel = queued.pixel,
+					.depth = queued.depth + 1
+				});
+			}
+		}
+	});
+
+	// Compact spawned rays into the next queue, prefix sum gives each tile its own segment
+	next.tileOffsets.resize(numTiles + 1);
+	next.tileOffsets[0] = 0;
+	for (int tile = 0; tile < numTiles; tile++)
+		next.tileOffsets[tile + 1] = next.tileOffsets[tile] + (int)tileSpawned[tile].size();
+
+	next.rays.resize(next.tileOffsets[numTiles]);
+
+	concurrency::parallel_for(0, numTiles, [&](int tile) {
+		std::copy(tileSpawned[tile].begin(), tileSpawned[tile].end(), next.rays.begin() + next.tileOffsets[tile]);
+	});
+}
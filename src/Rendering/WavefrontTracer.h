@@ -0,0 +1,84 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Engine/Common.h"
+#include "Engine/Timer.h"
+#include "Game/Scene.h"
+#include "Rendering/RayResult.h"
+
+class Raytracer;
+
+// Alternative to the recursive TracePath, traces the main pass stage by stage
+// Each bounce fills a queue of rays that's processed in parallel as a whole: primary -> shadow -> reflection/transparency -> ...
+// Queues are segmented per screen tile so each tile's pixels are only ever written by one thread
+class WavefrontTracer {
+public:
+
+	// Max bounces, same as the recursion limit in TracePath
+	static constexpr int MAX_DEPTH = 2;
+
+	// Tiles processed per batch, bounds the memory used by the queues regardless of resolution
+	static constexpr int TILES_PER_BATCH = 2048;
+
+	// Traces the scene into target, width and height have to be multiples of tileSize
+	// If sortRays is set, secondary and shadow rays are traced in RaySort order
+	void Render(const Raytracer& raytracer, const Scene& scene, const glm::mat4x4& projInv, const glm::mat4x4& viewInv,
+		Color* target, int width, int height, int tileSize, bool sortRays, Timer& sortTimer);
+
+private:
+
+	// A ray waiting to be traced and where its contribution goes
+	struct QueuedRay {
+		Ray ray;
+		float weight; // Contribution of this ray to the final pixel color
+		float cumulativeDepth;
+		int pixel; // Index in the batch, not the screen
+		int depth;
+	};
+
+	// A shadow ray towards a single light, continued through alpha tested blockers
+	struct ShadowRay {
+		enum State : uint8_t { Unused, Active, Blocked, Clear };
+		glm::vec3 ro;
+		glm::vec3 to;
+		float blockerDist;
+		int mask;
+		int continuations;
+		State state;
+	};
+
+	// Ray queue segmented per tile, rays of tile i are in [tileOffsets[i], tileOffsets[i + 1])
+	struct RayQueue {
+		std::vector<QueuedRay> rays;
+		std::vector<int> tileOffsets;
+	};
+
+	// Generates the camera rays for the current batch of tiles
+	void GeneratePrimary(const Scene& scene, const glm::mat4x4& projInv, const glm::mat4x4& viewInv);
+
+	// Traces the current queue and sets up shadow rays for everything that hit
+	void TraceQueue(const Raytracer& raytracer, const Scene& scene, bool sort, Timer& sortTimer);
+
+	// Traces all shadow rays, repeating for ones that passed through cutout surfaces
+	void TraceShadows(const Raytracer& raytracer, const Scene& scene, bool sort, Timer& sortTimer);
+
+	// Shades hit points and compacts spawned reflection/transparency rays into the next queue
+	void Shade(const Scene& scene, RayQueue& next);
+
+	// Per batch state, kept around to avoid reallocating every frame
+	RayQueue queue, nextQueue;
+	std::vector<uint64_t> traceOrder; // Packed RaySort keys
+	std::vector<RayResult> hits;
+	std::vector<v2f> interpolated;
+	std::vector<ShadowRay> shadowRays; // numLights slots per ray
+	std::vector<float> shadowTerms; // Resolved shadow per shadow ray slot, passed to shaders
+	std::vector<int> activeShadows, nextActiveShadows;
+	std::vector<std::vector<QueuedRay>> tileSpawned;
+	std::vector<glm::vec4> accumulated; // Per pixel of the current batch
+
+	int width = 0, height = 0, tileSize = 0, numXtiles = 0;
+	int firstTile = 0, batchTiles = 0; // Current batch
+	int numLights = 0;
+};